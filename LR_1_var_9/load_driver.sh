@@ -2,8 +2,8 @@
 
 echo "Загрузка драйвера scull_ring..."
 
-# Загружаем модуль
-sudo insmod scull_ring.ko
+# Загружаем модуль (параметры передаются как есть, например scull_ring_nr_devs=8)
+sudo insmod scull_ring.ko "$@"
 
 # Получаем major номер
 MAJOR=$(cat /proc/devices | grep scull_ring | awk '{print $1}')
@@ -15,13 +15,9 @@ fi
 
 echo "Драйвер загружен с major номером: $MAJOR"
 
-# Создаем узлы устройств
-sudo mknod /dev/scull_ring0 c $MAJOR 0
-sudo mknod /dev/scull_ring1 c $MAJOR 1
-sudo mknod /dev/scull_ring2 c $MAJOR 2
-
-# Устанавливаем права
-sudo chmod 666 /dev/scull_ring*
+# Узлы /dev/scull_ringN и /dev/scull_ring_ctl создает сам драйвер (device_create),
+# права 666 выставляются там же - ждем, пока udev их обработает
+udevadm settle 2>/dev/null
 
 echo "Узлы устройств созданы:"
-ls -l /dev/scull_ring*
\ No newline at end of file
+ls -l /dev/scull_ring*
@@ -8,16 +8,16 @@
 #include <sys/ioctl.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
 // IOCTL команды для взаимодействия с драйвером scull_ring
-#define SCULL_RING_IOCTL_GET_STATUS _IOR('s', 1, int[4])      // Получить статус буфера
-#define SCULL_RING_IOCTL_GET_COUNTERS _IOR('s', 2, long[2])   // Получить счетчики операций
-#define SCULL_RING_IOCTL_PEEK_BUFFER _IOWR('s', 10, char[512]) // Просмотреть содержимое буфера
+#include "scull_ring_ioctl.h"
 
 // Пути к устройствам драйвера
 #define DEV_SCULL0 "/dev/scull_ring0"
 #define DEV_SCULL1 "/dev/scull_ring1"
 #define DEV_SCULL2 "/dev/scull_ring2"
+#define DEV_SCULL_CTL "/dev/" SCULL_RING_CTL_NAME
 
 // Глобальная переменная для graceful shutdown по сигналу
 volatile sig_atomic_t keep_running = 1;
@@ -40,41 +40,113 @@ void print_timestamp() {
     printf("[%02d:%02d:%02d] ", t->tm_hour, t->tm_min, t->tm_sec);
 }
 
+#define SNAP_DATA_SIZE 4096     // Сколько байт кольца запрашивать у драйвера
+#define SNAP_MAX_DESC 256       // Сколько сообщений описывать
+
+/**
+ * Получение содержимого буфера двоичным снимком и форматирование его здесь
+ * @fd: файловый дескриптор устройства
+ * @out: буфер для строки вида "[msg1, msg2] +Nb more"
+ * @out_size: размер out
+ * Возвращает 0 или -1 (errno от ioctl)
+ *
+ * Драйвер отдает сырые байты и границы сообщений, строки собираются в
+ * пользовательском пространстве.
+ */
+int format_snapshot(int fd, char *out, size_t out_size) {
+    static char data[SNAP_DATA_SIZE];
+    static struct scull_ring_rec_desc desc[SNAP_MAX_DESC];
+    struct scull_ring_snapshot snap;
+    size_t used = 0;
+    unsigned int i;
+
+    memset(&snap, 0, sizeof(snap));
+    snap.version = SCULL_RING_SNAPSHOT_VERSION;
+    snap.nr_desc = SNAP_MAX_DESC;
+    snap.data_size = sizeof(data);
+    snap.desc = (__u64)(uintptr_t)desc;
+    snap.data = (__u64)(uintptr_t)data;
+    if (ioctl(fd, SCULL_RING_IOCTL_SNAPSHOT, &snap) != 0) {
+        return -1;
+    }
+
+    if (snap.data_len == 0) {
+        snprintf(out, out_size, "Empty");
+        return 0;
+    }
+
+    used += snprintf(out + used, out_size - used, "[");
+    for (i = 0; i < snap.nr_desc && used < out_size - 24; i++) {
+        // Первые 19 символов сообщения
+        int len = desc[i].len < 19 ? desc[i].len : 19;
+        used += snprintf(out + used, out_size - used, "%s%.*s",
+                         i ? ", " : "", len, data + desc[i].offset);
+    }
+    used += snprintf(out + used, out_size - used, "]");
+
+    // Строка заполнена раньше, чем кончились сообщения - хвост считается от
+    // начала первого не показанного (в режиме записей - от его заголовка)
+    if (i < snap.nr_desc) {
+        snap.more = snap.data_len - desc[i].offset;
+        if (snap.flags & SCULL_RING_F_RECORD) {
+            snap.more += sizeof(struct scull_ring_rec_hdr);
+        }
+    }
+    if (snap.more) {
+        snprintf(out + used, out_size - used, " +%ub more", snap.more);
+    }
+    return 0;
+}
+
 /**
  * Получение и отображение детальной информации о состоянии устройства
  * @fd: файловый дескриптор устройства
- * @dev_name: имя устройства для отображения
+ * @dev_name: имя устройства для отображения (при st - по st->minor)
  * @last_reads: массив счетчиков чтения с предыдущей итерации
  * @last_writes: массив счетчиков записи с предыдущей итерации
  * @dev_index: индекс устройства (0, 1, 2) для отслеживания истории
+ * @st: статистика устройства из общего вызова GET_ALL_STATS или NULL
  * 
- * Функция собирает через IOCTL:
+ * Функция собирает через IOCTL (если st == NULL):
  * - Статус буфера (заполненность, размер)
  * - Счетчики операций (чтение/запись)
  * - Содержимое буфера (последние сообщения)
  * - Разницу счетчиков с предыдущим измерением
  */
-void print_detailed_status(int fd, const char* dev_name, long *last_reads, long *last_writes, int dev_index) {
+void print_detailed_status(int fd, const char* dev_name, long *last_reads, long *last_writes, int dev_index,
+                           const struct scull_ring_dev_stats *st) {
     int status[4];              // Статус буфера: [data_len, size, 0, 0]
     long counters[2];           // Счетчики: [read_count, write_count]
     char buffer_content[512];   // Буфер для содержимого
     static int first_run[3] = {1, 1, 1};  // Флаг первого запуска для каждого устройства
+    char name[16];
     int ret;
     
-    // Получение статуса буфера через IOCTL
-    ret = ioctl(fd, SCULL_RING_IOCTL_GET_STATUS, status);
-    if (ret != 0) {
-        print_timestamp();
-        printf("%s: Error reading status\n", dev_name);
-        return;
-    }
-    
-    // Получение счетчиков операций через IOCTL
-    ret = ioctl(fd, SCULL_RING_IOCTL_GET_COUNTERS, counters);
-    if (ret != 0) {
-        print_timestamp();
-        printf("%s: Error reading counters\n", dev_name);
-        return;
+    if (st) {
+        // Имя берем из записи: номера колец после CREATE/DESTROY идут с пропусками
+        snprintf(name, sizeof(name), "scull%u", st->minor);
+        dev_name = name;
+        // Статус и счетчики уже получены одним вызовом для всех устройств
+        status[0] = st->data_len;
+        status[1] = st->size;
+        counters[0] = st->read_msgs;
+        counters[1] = st->write_msgs;
+    } else {
+        // Получение статуса буфера через IOCTL
+        ret = ioctl(fd, SCULL_RING_IOCTL_GET_STATUS, status);
+        if (ret != 0) {
+            print_timestamp();
+            printf("%s: Error reading status\n", dev_name);
+            return;
+        }
+        
+        // Получение счетчиков операций через IOCTL
+        ret = ioctl(fd, SCULL_RING_IOCTL_GET_COUNTERS, counters);
+        if (ret != 0) {
+            print_timestamp();
+            printf("%s: Error reading counters\n", dev_name);
+            return;
+        }
     }
     
     // Расчет разницы счетчиков с предыдущей итерацией
@@ -89,9 +161,13 @@ void print_detailed_status(int fd, const char* dev_name, long *last_reads, long
         first_run[dev_index] = 0;
     }
     
-    // Попытка получить содержимое буфера для отладки
+    // Попытка получить содержимое буфера для отладки; старый драйвер
+    // двоичного снимка не знает - тогда берем готовую строку PEEK_BUFFER
     memset(buffer_content, 0, sizeof(buffer_content));
-    ret = ioctl(fd, SCULL_RING_IOCTL_PEEK_BUFFER, buffer_content);
+    ret = format_snapshot(fd, buffer_content, sizeof(buffer_content));
+    if (ret != 0 && errno == ENOTTY) {
+        ret = ioctl(fd, SCULL_RING_IOCTL_PEEK_BUFFER, buffer_content);
+    }
     
     if (ret != 0) {
         // Ошибка при получении содержимого буфера - выводим только базовую информацию
@@ -117,6 +193,12 @@ void print_detailed_status(int fd, const char* dev_name, long *last_reads, long
             printf(" [R:+%ld W:+%ld]", read_diff, write_diff);
         }
         printf(" [Total:R%ld W%ld]\n", counters[0], counters[1]);
+        if (st) {
+            printf("    Bytes: R%llu W%llu  Blocked: R%llu W%llu  Dropped: %llu\n",
+                   (unsigned long long)st->read_bytes, (unsigned long long)st->write_bytes,
+                   (unsigned long long)st->read_blocked, (unsigned long long)st->write_blocked,
+                   (unsigned long long)st->dropped);
+        }
         printf("    Numbers: %s\n", buffer_content);  // Отображаем содержимое буфера
     }
     
@@ -125,6 +207,22 @@ void print_detailed_status(int fd, const char* dev_name, long *last_reads, long
     last_writes[dev_index] = counters[1];
 }
 
+/**
+ * Поиск статистики кольца по младшему номеру в ответе GET_ALL_STATS
+ * Возвращает запись или NULL, если кольца нет в ответе
+ */
+const struct scull_ring_dev_stats *find_stats(const struct scull_ring_dev_stats *stats, unsigned int nr,
+                                              unsigned int minor) {
+    unsigned int j;
+
+    for (j = 0; j < nr; j++) {
+        if (stats[j].minor == minor) {
+            return &stats[j];
+        }
+    }
+    return NULL;
+}
+
 /**
  * Основная функция монитора
  * 
@@ -140,6 +238,11 @@ void print_detailed_status(int fd, const char* dev_name, long *last_reads, long
  */
 int main() {
     int fd0, fd1, fd2;          // Файловые дескрипторы устройств
+    int ctl_fd;                 // Управляющее устройство (сводная статистика)
+    struct scull_ring_dev_stats stats[3];
+    struct scull_ring_stats req;
+    const struct scull_ring_dev_stats *st[3];
+    int i;
     int iteration = 0;          // Счетчик итераций мониторинга
     long last_reads[3] = {0};   // История счетчиков чтения для каждого устройства
     long last_writes[3] = {0};  // История счетчиков записи для каждого устройства
@@ -159,6 +262,9 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
+    // Без управляющего устройства (старый драйвер) статус берется у каждого кольца
+    ctl_fd = open(DEV_SCULL_CTL, O_RDONLY);
+
     printf("P4: Number Monitor Started. Press Ctrl+C to stop.\n\n");
 
     // Основной цикл мониторинга
@@ -169,12 +275,31 @@ int main() {
         // Заголовок с номером итерации
         printf("=== Number Flow Monitor (Iteration: %d) ===\n\n", iteration++);
         
+        // Статус и счетчики всех колец одним ioctl
+        for (i = 0; i < 3; i++) {
+            st[i] = NULL;
+        }
+        if (ctl_fd >= 0) {
+            memset(&req, 0, sizeof(req));
+            req.version = SCULL_RING_STATS_VERSION;
+            // Записи идут по возрастанию номера, поэтому кольца 0..2, если
+            // они есть, всегда среди первых трех
+            req.nr_devs = 3;
+            req.devs = (__u64)(uintptr_t)stats;
+            if (ioctl(ctl_fd, SCULL_RING_IOCTL_GET_ALL_STATS, &req) == 0) {
+                // Но позиция записи не равна номеру: после DESTROY номера идут с пропусками
+                for (i = 0; i < 3; i++) {
+                    st[i] = find_stats(stats, req.nr_devs, i);
+                }
+            }
+        }
+
         // Получение и отображение статуса для каждого устройства
-        print_detailed_status(fd0, "scull0", last_reads, last_writes, 0);
+        print_detailed_status(fd0, "scull0", last_reads, last_writes, 0, st[0]);
         printf("\n");
-        print_detailed_status(fd1, "scull1", last_reads, last_writes, 1);
+        print_detailed_status(fd1, "scull1", last_reads, last_writes, 1, st[1]);
         printf("\n");
-        print_detailed_status(fd2, "scull2", last_reads, last_writes, 2);
+        print_detailed_status(fd2, "scull2", last_reads, last_writes, 2, st[2]);
         
         // Легенда для понимания формата вывода
         printf("\nLegend: Data=current/size (fill%%), [R:+reads W:+writes] [Total:Rtotal Wtotal]\n");
@@ -189,5 +314,8 @@ int main() {
     close(fd0);
     close(fd1);
     close(fd2);
+    if (ctl_fd >= 0) {
+        close(ctl_fd);
+    }
     return 0;
 }
@@ -0,0 +1,346 @@
+#define _GNU_SOURCE            // ppoll()
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+// IOCTL команды и формат заголовка записи драйвера scull_ring
+#include "scull_ring_ioctl.h"
+
+// Цепочка P1 -> scull0 -> P2 -> scull1 -> P3 -> scull2 -> P1
+#define DEV_SCULL0 "/dev/scull_ring0"
+#define DEV_SCULL1 "/dev/scull_ring1"
+#define DEV_SCULL2 "/dev/scull_ring2"
+#define NR_HOPS 3
+
+#define DEFAULT_COUNT 10000        // Сколько сообщений отправляет P1
+#define MAX_COUNT 1000000          // Наибольшее count: 4 массива по 8 байт на сообщение
+#define DEFAULT_INTERVAL_US 1000   // Пауза между отправками P1
+
+/*
+ * Сообщение трассировки. Каждый этап, забрав сообщение из кольца,
+ * дописывает время, которое оно пролежало в этом кольце (от метки
+ * драйвера tstamp_ns до чтения), и пересылает дальше. P1 получает
+ * сообщение обратно и видит все три перегона и общее время.
+ */
+struct trace_msg {
+    unsigned int id;                       // Номер сообщения у P1
+    unsigned int hops;                     // Сколько перегонов заполнено
+    unsigned long long origin_ns;          // CLOCK_MONOTONIC отправки из P1
+    unsigned long long hop_ns[NR_HOPS];    // Время в scull0, scull1, scull2
+};
+
+// Прочитанная запись: заголовок драйвера и данные
+struct trace_rec {
+    struct scull_ring_rec_hdr hdr;
+    struct trace_msg msg;
+};
+
+// Глобальная переменная для graceful shutdown по сигналу
+volatile sig_atomic_t keep_running = 1;
+
+/**
+ * Обработчик сигнала для graceful shutdown
+ */
+void signal_handler(int sig) {
+    keep_running = 0;
+}
+
+/**
+ * Текущее время CLOCK_MONOTONIC в наносекундах (та же шкала, что tstamp_ns)
+ */
+unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Открытие кольца с проверкой режима
+ * @path: путь к устройству
+ * @flags: флаги open()
+ * @meta: включить чтение с заголовком (SCULL_RING_IOCTL_SET_READ_META)
+ * Возвращает дескриптор или -1
+ *
+ * Метки времени и номера ставит драйвер, поэтому кольцо должно быть
+ * загружено в режиме записей с метками (scull_ring_flags=3,3,3).
+ */
+int open_ring(const char *path, int flags, int meta) {
+    __u32 mode = 0;
+    __u32 on = 1;
+    int fd;
+
+    fd = open(path, flags);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (ioctl(fd, SCULL_RING_IOCTL_GET_FLAGS, &mode) < 0 ||
+        (mode & (SCULL_RING_F_RECORD | SCULL_RING_F_TIMESTAMP)) !=
+            (SCULL_RING_F_RECORD | SCULL_RING_F_TIMESTAMP)) {
+        fprintf(stderr, "%s: ring must be in record + timestamp mode (scull_ring_flags=3,3,3)\n", path);
+        close(fd);
+        return -1;
+    }
+    if (meta && ioctl(fd, SCULL_RING_IOCTL_SET_READ_META, &on) < 0) {
+        perror("SCULL_RING_IOCTL_SET_READ_META");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Чтение одного сообщения с заголовком драйвера
+ * @fd: дескриптор с включенным SET_READ_META
+ * @rec: куда положить заголовок и сообщение
+ * @last_seq: последний увиденный номер записи этого кольца (обновляется)
+ * @seen: была ли уже запись (обновляется; первый номер может быть 0)
+ * @gaps: счетчик пропусков в нумерации (обновляется)
+ * Возвращает 1 - сообщение прочитано, 0 - чужое/усеченное, -1 - ошибка
+ */
+int read_trace(int fd, struct trace_rec *rec, unsigned int *last_seq, int *seen, unsigned long *gaps) {
+    ssize_t n = read(fd, rec, sizeof(*rec));
+
+    if (n < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+    if (n != sizeof(*rec) || rec->hdr.len != sizeof(rec->msg)) {
+        return 0;
+    }
+    // Номера выдаются устройством подряд: разрыв - потерянные записи
+    if (*seen && rec->hdr.seq != *last_seq + 1) {
+        (*gaps)++;
+    }
+    *last_seq = rec->hdr.seq;
+    *seen = 1;
+    return 1;
+}
+
+int compare_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Печать перцентилей задержки
+ * @name: подпись строки
+ * @samples: выборка в наносекундах (сортируется на месте)
+ * @n: размер выборки
+ */
+void print_percentiles(const char *name, unsigned long long *samples, size_t n) {
+    if (n == 0) {
+        printf("%-10s no samples\n", name);
+        return;
+    }
+    qsort(samples, n, sizeof(*samples), compare_ull);
+    printf("%-10s n=%zu p50=%.1f us p99=%.1f us p999=%.1f us max=%.1f us\n", name, n,
+           samples[n * 50 / 100] / 1000.0, samples[n * 99 / 100] / 1000.0,
+           samples[n * 999 / 1000] / 1000.0, samples[n - 1] / 1000.0);
+}
+
+/**
+ * Этап P1: отправляет сообщения в scull0 и собирает их из scull2
+ * @count: сколько сообщений отправить (1..MAX_COUNT)
+ * @interval_us: пауза между отправками
+ *
+ * Отправка идет по расписанию, а ожидание ответа - через ppoll() до
+ * времени следующей отправки, поэтому медленная цепочка не тормозит
+ * источник (открытый цикл).
+ */
+int run_source(unsigned int count, unsigned int interval_us) {
+    unsigned long long *hop[NR_HOPS], *total;
+    unsigned long long next, now;
+    unsigned int sent = 0, received = 0, last_seq = 0;
+    unsigned long gaps = 0;
+    int seen = 0;
+    struct trace_msg msg;
+    struct trace_rec rec;
+    struct pollfd pfd;
+    struct timespec ts;
+    int fd_write, fd_read;
+    int i, ret = 0;
+
+    fd_write = open_ring(DEV_SCULL0, O_WRONLY, 0);
+    if (fd_write < 0) {
+        return 1;
+    }
+    fd_read = open_ring(DEV_SCULL2, O_RDONLY | O_NONBLOCK, 1);
+    if (fd_read < 0) {
+        close(fd_write);
+        return 1;
+    }
+    total = calloc(count, sizeof(*total));
+    ret = total == NULL;
+    for (i = 0; i < NR_HOPS; i++) {
+        hop[i] = calloc(count, sizeof(*hop[i]));
+        ret |= hop[i] == NULL;
+    }
+    if (ret) {
+        perror("P1: calloc");
+        for (i = 0; i < NR_HOPS; i++) {
+            free(hop[i]);
+        }
+        free(total);
+        close(fd_write);
+        close(fd_read);
+        return 1;
+    }
+
+    printf("P1: sending %u messages every %u us to %s, collecting from %s\n",
+           count, interval_us, DEV_SCULL0, DEV_SCULL2);
+
+    pfd.fd = fd_read;
+    pfd.events = POLLIN;
+    next = now_ns();
+    while (keep_running && received < count) {
+        now = now_ns();
+        if (sent < count && now >= next) {
+            memset(&msg, 0, sizeof(msg));
+            msg.id = sent;
+            msg.origin_ns = now;
+            if (write(fd_write, &msg, sizeof(msg)) < 0) {
+                perror("P1: Write to scull0 failed");
+                break;
+            }
+            sent++;
+            next += interval_us * 1000ULL;
+            continue;
+        }
+
+        // Ждем ответа до следующей отправки (после последней - до 1 с)
+        if (sent < count) {
+            ts.tv_sec = (next - now) / 1000000000ULL;
+            ts.tv_nsec = (next - now) % 1000000000ULL;
+        } else {
+            ts.tv_sec = 1;
+            ts.tv_nsec = 0;
+        }
+        if (ppoll(&pfd, 1, &ts, NULL) <= 0) {
+            if (sent == count && keep_running) {
+                fprintf(stderr, "P1: %u of %u messages lost\n", count - received, count);
+                break;
+            }
+            continue;
+        }
+        while (received < count && (ret = read_trace(fd_read, &rec, &last_seq, &seen, &gaps)) > 0) {
+            now = now_ns();
+            if (rec.msg.hops != NR_HOPS - 1) {
+                continue;
+            }
+            rec.msg.hop_ns[NR_HOPS - 1] = now - rec.hdr.tstamp_ns;
+            for (i = 0; i < NR_HOPS; i++) {
+                hop[i][received] = rec.msg.hop_ns[i];
+            }
+            total[received] = now - rec.msg.origin_ns;
+            received++;
+        }
+        if (ret < 0) {
+            perror("P1: Read from scull2 failed");
+            break;
+        }
+    }
+
+    printf("P1: sent %u, received %u, seq gaps on scull2: %lu\n", sent, received, gaps);
+    print_percentiles("scull0", hop[0], received);
+    print_percentiles("scull1", hop[1], received);
+    print_percentiles("scull2", hop[2], received);
+    print_percentiles("total", total, received);
+
+    for (i = 0; i < NR_HOPS; i++) {
+        free(hop[i]);
+    }
+    free(total);
+    close(fd_write);
+    close(fd_read);
+    return 0;
+}
+
+/**
+ * Этапы P2/P3: пересылка сообщений из одного кольца в следующее
+ * @stage: 2 или 3
+ *
+ * Дописывает в сообщение время, которое оно пролежало во входном кольце.
+ */
+int run_forward(int stage) {
+    const char *in = stage == 2 ? DEV_SCULL0 : DEV_SCULL1;
+    const char *out = stage == 2 ? DEV_SCULL1 : DEV_SCULL2;
+    unsigned int last_seq = 0;
+    unsigned long forwarded = 0, gaps = 0;
+    int seen = 0;
+    struct trace_rec rec;
+    int fd_read, fd_write;
+    int ret;
+
+    fd_read = open_ring(in, O_RDONLY, 1);
+    if (fd_read < 0) {
+        return 1;
+    }
+    fd_write = open_ring(out, O_WRONLY, 0);
+    if (fd_write < 0) {
+        close(fd_read);
+        return 1;
+    }
+
+    printf("P%d: forwarding %s -> %s. Press Ctrl+C to stop.\n", stage, in, out);
+    while (keep_running) {
+        ret = read_trace(fd_read, &rec, &last_seq, &seen, &gaps);
+        if (ret < 0) {
+            fprintf(stderr, "P%d: Read from %s failed: %s\n", stage, in, strerror(errno));
+            break;
+        }
+        if (ret == 0 || rec.msg.hops >= NR_HOPS) {
+            continue;
+        }
+        rec.msg.hop_ns[rec.msg.hops++] = now_ns() - rec.hdr.tstamp_ns;
+        if (write(fd_write, &rec.msg, sizeof(rec.msg)) < 0) {
+            fprintf(stderr, "P%d: Write to %s failed: %s\n", stage, out, strerror(errno));
+            break;
+        }
+        forwarded++;
+    }
+
+    printf("P%d: forwarded %lu messages, seq gaps on %s: %lu\n", stage, forwarded, in, gaps);
+    close(fd_read);
+    close(fd_write);
+    return 0;
+}
+
+/**
+ * Трассировка задержки по цепочке P1 -> P2 -> P3 -> P1
+ *
+ * Запуск (кольца загружены с scull_ring_flags=3,3,3):
+ *   ./p5 3 &  ./p5 2 &  ./p5 1 [count] [interval_us]
+ * Этапы 2 и 3 пересылают сообщения, этап 1 отправляет их и печатает
+ * перцентили задержки каждого перегона и всей цепочки.
+ */
+int main(int argc, char *argv[]) {
+    struct sigaction sa;
+    unsigned long count = DEFAULT_COUNT;
+    int stage;
+
+    if (argc > 2) {
+        count = strtoul(argv[2], NULL, 0);
+    }
+    if (argc < 2 || (stage = atoi(argv[1])) < 1 || stage > NR_HOPS || count < 1 || count > MAX_COUNT) {
+        fprintf(stderr, "usage: %s 1 [count 1..%u] [interval_us] | 2 | 3\n", argv[0], MAX_COUNT);
+        return 1;
+    }
+
+    // Без SA_RESTART: Ctrl+C прерывает блокирующий read()
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+
+    if (stage == 1) {
+        return run_source(count, argc > 3 ? strtoul(argv[3], NULL, 0) : DEFAULT_INTERVAL_US);
+    }
+    return run_forward(stage);
+}
@@ -0,0 +1,541 @@
+#define _GNU_SOURCE            // pthread_setaffinity_np(), CPU_SET
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <stdint.h>
+
+// IOCTL команды и формат заголовка записи драйвера scull_ring
+#include "scull_ring_ioctl.h"
+
+#define MAX_DEVS 16             // Сколько устройств можно нагрузить одновременно
+#define MAX_THREADS 256         // Всего потоков (писатели и читатели всех устройств)
+#define MAX_CPUS 256            // Длина списка процессоров для привязки
+#define MAX_BATCH 1024          // Сообщений в одном writev()
+#define MAX_MSG_SIZE 65536      // Наибольшее сообщение
+#define STAMP_LEN 16            // Метка времени в начале сообщения (hex)
+#define LAT_SUB_BITS 4          // Точность гистограммы: 2^4 ступеней на степень двойки
+#define LAT_BUCKETS (64 << LAT_SUB_BITS)
+
+/*
+ * Сообщение - строка: 16 hex-цифр времени отправки (CLOCK_MONOTONIC, нс),
+ * заполнитель и '\0'. Так оно разбирается и в потоке байт (сообщения
+ * разделены нулями), и в режиме записей.
+ */
+
+// Параметры запуска
+struct config {
+    const char *devs[MAX_DEVS];     // Нагружаемые устройства
+    int nr_devs;
+    int producers;                  // Писателей на устройство
+    int consumers;                  // Читателей на устройство
+    unsigned int size_min;          // Размер сообщения, включая '\0'
+    unsigned int size_max;
+    unsigned int batch;             // Сообщений на writev()/readv()
+    double rate;                    // Сообщений в секунду на устройство (0 - без ограничения)
+    double duration;                // Длительность замера, с
+    int cpus[MAX_CPUS];             // Процессоры для привязки потоков по кругу
+    int nr_cpus;
+};
+
+// Результаты одного устройства (поля меняются атомарно из потоков)
+struct dev_stats {
+    unsigned long long sent_msgs;
+    unsigned long long sent_bytes;
+    unsigned long long recv_msgs;
+    unsigned long long recv_bytes;
+    unsigned long long write_errors;
+    unsigned long long read_errors;
+    unsigned long long lat[LAT_BUCKETS];   // Гистограмма задержки, нс
+    unsigned long long lat_max;
+    unsigned int flags;                    // Режим кольца SCULL_RING_F_*
+};
+
+// Аргумент потока
+struct worker {
+    pthread_t thread;
+    struct dev_stats *st;
+    const char *dev;
+    int cpu;                        // -1 - без привязки
+    int producer;
+    unsigned int seed;
+};
+
+static struct config cfg = {
+    .producers = 1,
+    .consumers = 1,
+    .size_min = 64,
+    .size_max = 64,
+    .batch = 1,
+    .duration = 5,
+};
+static struct dev_stats stats[MAX_DEVS];
+static struct worker workers[MAX_THREADS];
+static volatile int producers_running = 1;   // Писатели работают
+static volatile int consumers_running = 1;   // Читатели работают (дочитывают после писателей)
+
+/**
+ * Текущее время CLOCK_MONOTONIC в наносекундах (та же шкала, что tstamp_ns)
+ */
+static unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Номер ячейки гистограммы для значения: степень двойки и LAT_SUB_BITS
+ * следующих за старшим битов (погрешность около 6%)
+ */
+static int lat_bucket(unsigned long long v) {
+    int msb;
+
+    if (v < (1ULL << LAT_SUB_BITS)) {
+        return v;
+    }
+    msb = 63 - __builtin_clzll(v);
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) | ((v >> (msb - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1));
+}
+
+// Нижняя граница ячейки (обратное к lat_bucket)
+static unsigned long long lat_value(int bucket) {
+    int shift = (bucket >> LAT_SUB_BITS) - 1;
+
+    if (shift < 0) {
+        return bucket;
+    }
+    return ((1ULL << LAT_SUB_BITS) | (bucket & ((1 << LAT_SUB_BITS) - 1))) << shift;
+}
+
+static unsigned long long lat_percentile(const struct dev_stats *st, double p) {
+    unsigned long long total = 0, seen = 0;
+    int i;
+
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        total += st->lat[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        seen += st->lat[i];
+        if (seen > total * p) {
+            return lat_value(i);
+        }
+    }
+    return st->lat_max;
+}
+
+/**
+ * Привязка потока к процессору
+ */
+static void pin_thread(int cpu) {
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+        fprintf(stderr, "loadgen: can't pin to CPU %d\n", cpu);
+    }
+}
+
+/**
+ * Поток-писатель: пачками по cfg.batch сообщений через writev()
+ *
+ * С заданной частотой отправка идет по расписанию (открытый цикл), а в
+ * сообщение кладется плановое время отправки: если драйвер задержал
+ * writev(), задержка попадет в измерение, а не спрячется.
+ */
+static void *producer_thread(void *arg) {
+    struct worker *w = arg;
+    struct iovec iov[MAX_BATCH];
+    unsigned long long next, interval = 0, stamp;
+    struct timespec ts;
+    char *msgs;
+    unsigned int i, len;
+    ssize_t n;
+    int fd;
+
+    pin_thread(w->cpu);
+    fd = open(w->dev, O_WRONLY);
+    if (fd < 0) {
+        perror(w->dev);
+        return NULL;
+    }
+    msgs = malloc((size_t)cfg.batch * cfg.size_max);
+    if (!msgs) {
+        perror("malloc");
+        close(fd);
+        return NULL;
+    }
+    if (cfg.rate > 0) {
+        interval = 1e9 * cfg.batch * cfg.producers / cfg.rate;
+    }
+
+    next = now_ns();
+    while (producers_running) {
+        if (interval) {
+            ts.tv_sec = next / 1000000000ULL;
+            ts.tv_nsec = next % 1000000000ULL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            stamp = next;
+            next += interval;
+        } else {
+            stamp = now_ns();
+        }
+        for (i = 0; i < cfg.batch; i++) {
+            len = cfg.size_min;
+            if (cfg.size_max > cfg.size_min) {
+                len += rand_r(&w->seed) % (cfg.size_max - cfg.size_min + 1);
+            }
+            iov[i].iov_base = msgs + (size_t)i * cfg.size_max;
+            iov[i].iov_len = len;
+            snprintf(iov[i].iov_base, STAMP_LEN + 1, "%016llx", stamp);
+            memset((char *)iov[i].iov_base + STAMP_LEN, 'x', len - STAMP_LEN - 1);
+            ((char *)iov[i].iov_base)[len - 1] = '\0';
+        }
+        n = cfg.batch == 1 ? write(fd, iov[0].iov_base, iov[0].iov_len) : writev(fd, iov, cfg.batch);
+        if (n < 0) {
+            if (errno != EINTR) {
+                __atomic_add_fetch(&w->st->write_errors, 1, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+        // writev() кладет столько целых сообщений, сколько поместилось
+        for (i = 0; i < cfg.batch && n >= (ssize_t)iov[i].iov_len; i++) {
+            n -= iov[i].iov_len;
+            __atomic_add_fetch(&w->st->sent_bytes, iov[i].iov_len, __ATOMIC_RELAXED);
+        }
+        __atomic_add_fetch(&w->st->sent_msgs, i, __ATOMIC_RELAXED);
+    }
+
+    free(msgs);
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Учет одного принятого сообщения
+ */
+static void account(const char *msg, unsigned int len, unsigned long long now,
+                    unsigned long long *lat, unsigned long long *lat_max) {
+    unsigned long long stamp, d;
+    char hex[STAMP_LEN + 1];
+
+    if (len < STAMP_LEN) {
+        return;
+    }
+    memcpy(hex, msg, STAMP_LEN);
+    hex[STAMP_LEN] = '\0';
+    stamp = strtoull(hex, NULL, 16);
+    d = now > stamp ? now - stamp : 0;
+    lat[lat_bucket(d)]++;
+    if (d > *lat_max) {
+        *lat_max = d;
+    }
+}
+
+/**
+ * Поток-читатель: read() по одному сообщению или readv() пачкой
+ *
+ * readv() отдает целые сообщения в формате кольца: в режиме записей
+ * заголовок и данные, в потоке байт - строки, разделенные '\0'.
+ */
+static void *consumer_thread(void *arg) {
+    struct worker *w = arg;
+    size_t cap = (size_t)cfg.batch * (cfg.size_max + sizeof(struct scull_ring_rec_hdr));
+    unsigned long long *lat = calloc(LAT_BUCKETS, sizeof(*lat));
+    unsigned long long lat_max = 0, msgs = 0, bytes = 0, now;
+    struct scull_ring_rec_hdr hdr;
+    struct pollfd pfd;
+    struct iovec iov;
+    char *buf = malloc(cap);
+    size_t off, end;
+    ssize_t n;
+    int record = w->st->flags & SCULL_RING_F_RECORD;
+    int i, fd;
+
+    pin_thread(w->cpu);
+    if (!buf || !lat) {
+        perror("malloc");
+        free(buf);
+        free(lat);
+        return NULL;
+    }
+    fd = open(w->dev, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror(w->dev);
+        free(buf);
+        free(lat);
+        return NULL;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    iov.iov_base = buf;
+    iov.iov_len = cap;
+    while (consumers_running) {
+        n = cfg.batch == 1 ? read(fd, buf, cap) : readv(fd, &iov, 1);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                poll(&pfd, 1, 100);
+            } else if (errno != EINTR) {
+                __atomic_add_fetch(&w->st->read_errors, 1, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+        now = now_ns();
+        if (cfg.batch == 1) {
+            // read() отдает данные одного сообщения без заголовка
+            account(buf, n, now, lat, &lat_max);
+            msgs++;
+            bytes += n;
+            continue;
+        }
+        for (off = 0; off < (size_t)n; off = end) {
+            if (record) {
+                if (n - off < sizeof(hdr)) {
+                    break;
+                }
+                memcpy(&hdr, buf + off, sizeof(hdr));
+                off += sizeof(hdr);
+                end = off + hdr.len;
+            } else {
+                end = off;
+                while (end < (size_t)n && buf[end] != '\0') {
+                    end++;
+                }
+                end++;
+            }
+            account(buf + off, end - off, now, lat, &lat_max);
+            msgs++;
+            bytes += end - off;
+        }
+    }
+
+    // Слияние своей гистограммы с гистограммой устройства
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        if (lat[i]) {
+            __atomic_add_fetch(&w->st->lat[i], lat[i], __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_add_fetch(&w->st->recv_msgs, msgs, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&w->st->recv_bytes, bytes, __ATOMIC_RELAXED);
+    for (now = w->st->lat_max; lat_max > now; now = w->st->lat_max) {
+        __atomic_compare_exchange_n(&w->st->lat_max, &now, lat_max, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    close(fd);
+    free(buf);
+    free(lat);
+    return NULL;
+}
+
+/**
+ * Разбор размера сообщения: N или MIN:MAX (байт, включая '\0')
+ */
+static int parse_size(const char *s) {
+    char *end;
+
+    cfg.size_min = strtoul(s, &end, 0);
+    cfg.size_max = *end == ':' ? strtoul(end + 1, NULL, 0) : cfg.size_min;
+    return cfg.size_min < STAMP_LEN + 1 || cfg.size_max < cfg.size_min || cfg.size_max > MAX_MSG_SIZE;
+}
+
+/**
+ * Разбор списка процессоров: "0,2,4-7"
+ */
+static int parse_cpus(const char *s) {
+    int a, b;
+    char *end;
+
+    while (*s) {
+        a = b = strtol(s, &end, 10);
+        if (end == s) {
+            return 1;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+        }
+        for (; a <= b && cfg.nr_cpus < MAX_CPUS; a++) {
+            cfg.cpus[cfg.nr_cpus++] = a;
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-d dev]... [-p producers] [-c consumers] [-s size|min:max]\n"
+            "          [-b batch] [-r msgs_per_s] [-t seconds] [-C cpu_list]\n"
+            "  -d  device to load (repeat for several, default /dev/scull_ring0)\n"
+            "  -p  producer threads per device (default 1)\n"
+            "  -c  consumer threads per device (default 1)\n"
+            "  -s  message size in bytes incl. NUL, >= %d (default 64)\n"
+            "  -b  messages per writev()/readv() (default 1 = write()/read())\n"
+            "  -r  target rate per device, 0 = as fast as possible (default 0)\n"
+            "  -t  duration in seconds (default 5)\n"
+            "  -C  CPUs to pin threads to round-robin, e.g. 0,2,4-7\n",
+            prog, STAMP_LEN + 1);
+}
+
+/**
+ * Печать результата в JSON
+ */
+static void print_json(double elapsed) {
+    struct dev_stats *st;
+    int d;
+
+    printf("{\n  \"duration_s\": %.3f,\n  \"producers\": %d,\n  \"consumers\": %d,\n"
+           "  \"msg_size_min\": %u,\n  \"msg_size_max\": %u,\n  \"batch\": %u,\n"
+           "  \"target_rate\": %.0f,\n  \"devices\": [\n",
+           elapsed, cfg.producers, cfg.consumers, cfg.size_min, cfg.size_max, cfg.batch, cfg.rate);
+    for (d = 0; d < cfg.nr_devs; d++) {
+        st = &stats[d];
+        printf("    {\n      \"device\": \"%s\",\n      \"flags\": %u,\n"
+               "      \"sent_msgs\": %llu,\n      \"recv_msgs\": %llu,\n"
+               "      \"write_errors\": %llu,\n      \"read_errors\": %llu,\n"
+               "      \"send_msgs_per_s\": %.0f,\n      \"recv_msgs_per_s\": %.0f,\n"
+               "      \"recv_mb_per_s\": %.2f,\n"
+               "      \"latency_us\": { \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f }\n"
+               "    }%s\n",
+               cfg.devs[d], st->flags, st->sent_msgs, st->recv_msgs, st->write_errors, st->read_errors,
+               st->sent_msgs / elapsed, st->recv_msgs / elapsed, st->recv_bytes / elapsed / 1e6,
+               lat_percentile(st, 0.50) / 1e3, lat_percentile(st, 0.99) / 1e3,
+               lat_percentile(st, 0.999) / 1e3, st->lat_max / 1e3,
+               d + 1 < cfg.nr_devs ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+/**
+ * Нагрузочный тест драйвера scull_ring
+ *
+ * На каждое устройство запускается cfg.producers писателей и
+ * cfg.consumers читателей. Писатели кладут в сообщение время отправки,
+ * читатели считают задержку до приема. После cfg.duration секунд
+ * писатели останавливаются, читатели дочитывают очередь, и результат
+ * печатается в JSON (stdout), чтобы сравнивать изменения драйвера.
+ */
+int main(int argc, char *argv[]) {
+    unsigned long long start;
+    struct timespec ts;
+    double elapsed;
+    int nr_workers = 0;
+    int opt, d, i, fd;
+
+    while ((opt = getopt(argc, argv, "d:p:c:s:b:r:t:C:h")) != -1) {
+        switch (opt) {
+            case 'd':
+                if (cfg.nr_devs == MAX_DEVS) {
+                    fprintf(stderr, "loadgen: at most %d devices\n", MAX_DEVS);
+                    return 1;
+                }
+                cfg.devs[cfg.nr_devs++] = optarg;
+                break;
+            case 'p': cfg.producers = atoi(optarg); break;
+            case 'c': cfg.consumers = atoi(optarg); break;
+            case 's':
+                if (parse_size(optarg)) {
+                    fprintf(stderr, "loadgen: bad size %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'b': cfg.batch = atoi(optarg); break;
+            case 'r': cfg.rate = atof(optarg); break;
+            case 't': cfg.duration = atof(optarg); break;
+            case 'C':
+                if (parse_cpus(optarg)) {
+                    fprintf(stderr, "loadgen: bad CPU list %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (cfg.nr_devs == 0) {
+        cfg.devs[cfg.nr_devs++] = "/dev/scull_ring0";
+    }
+    if (cfg.producers < 1 || cfg.consumers < 1 || cfg.batch < 1 || cfg.batch > MAX_BATCH ||
+        cfg.duration <= 0 || cfg.rate < 0 ||
+        cfg.nr_devs * (cfg.producers + cfg.consumers) > MAX_THREADS) {
+        usage(argv[0]);
+        return 1;
+    }
+    // Буфер пачки читателя: batch * (size_max + заголовок) не должен переполнить size_t
+    if (cfg.batch > SIZE_MAX / (cfg.size_max + sizeof(struct scull_ring_rec_hdr))) {
+        fprintf(stderr, "%s: batch * size too large\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Режим кольца нужен читателям, чтобы разбирать readv()
+    for (d = 0; d < cfg.nr_devs; d++) {
+        fd = open(cfg.devs[d], O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            perror(cfg.devs[d]);
+            return 1;
+        }
+        ioctl(fd, SCULL_RING_IOCTL_GET_FLAGS, &stats[d].flags);
+        close(fd);
+    }
+
+    // Читатели стартуют первыми, чтобы не пропустить начало потока
+    for (i = 0; i < 2; i++) {
+        for (d = 0; d < cfg.nr_devs; d++) {
+            int n = i ? cfg.producers : cfg.consumers;
+            while (n--) {
+                struct worker *w = &workers[nr_workers];
+                w->st = &stats[d];
+                w->dev = cfg.devs[d];
+                w->producer = i;
+                w->cpu = cfg.nr_cpus ? cfg.cpus[nr_workers % cfg.nr_cpus] : -1;
+                w->seed = nr_workers + 1;
+                if (pthread_create(&w->thread, NULL, i ? producer_thread : consumer_thread, w)) {
+                    perror("pthread_create");
+                    return 1;
+                }
+                nr_workers++;
+            }
+        }
+    }
+    start = now_ns();
+
+    ts.tv_sec = (time_t)cfg.duration;
+    ts.tv_nsec = (cfg.duration - ts.tv_sec) * 1e9;
+    nanosleep(&ts, NULL);
+    producers_running = 0;
+    for (i = 0; i < nr_workers; i++) {
+        if (workers[i].producer) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    // Даем читателям забрать остаток очереди
+    usleep(200000);
+    consumers_running = 0;
+    for (i = 0; i < nr_workers; i++) {
+        if (!workers[i].producer) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    print_json(elapsed);
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+// IOCTL команды драйвера scull_ring
+#include "scull_ring_ioctl.h"
+
+#define DEV_SCULL0 "/dev/scull_ring0"
+#define DEV_CTL "/dev/scull_ring_ctl"
+
+// Количество проваленных проверок
+static int failures = 0;
+
+/**
+ * Проверка, что вызов завершился ошибкой с нужным кодом
+ * @name: что проверялось
+ * @ret: результат вызова
+ * @expected: ожидаемый errno
+ */
+static void expect_errno(const char *name, int ret, int expected) {
+    if (ret == -1 && errno == expected) {
+        printf("ok   %s: %s\n", name, strerror(expected));
+        return;
+    }
+    printf("FAIL %s: ret=%d errno=%s, ожидалось %s\n",
+           name, ret, ret == -1 ? strerror(errno) : "-", strerror(expected));
+    failures++;
+}
+
+/**
+ * SET_EVENTFD с дескриптором, который не является eventfd
+ * Драйвер должен вернуть -EINVAL и ничего не освобождать.
+ */
+static void check_eventfd_not_eventfd(int fd) {
+    struct scull_ring_eventfd req;
+    int other = open("/dev/null", O_RDONLY);
+
+    if (other < 0) {
+        perror("open /dev/null");
+        failures++;
+        return;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.fd = other;
+    req.events = SCULL_RING_EVENTFD_READ;
+    expect_errno("SET_EVENTFD READ, fd не eventfd", ioctl(fd, SCULL_RING_IOCTL_SET_EVENTFD, &req), EINVAL);
+
+    req.events = SCULL_RING_EVENTFD_WRITE;
+    expect_errno("SET_EVENTFD WRITE, fd не eventfd", ioctl(fd, SCULL_RING_IOCTL_SET_EVENTFD, &req), EINVAL);
+
+    req.events = SCULL_RING_EVENTFD_READ | SCULL_RING_EVENTFD_WRITE;
+    expect_errno("SET_EVENTFD READ|WRITE, fd не eventfd", ioctl(fd, SCULL_RING_IOCTL_SET_EVENTFD, &req), EINVAL);
+
+    req.fd = 1000000;
+    req.events = SCULL_RING_EVENTFD_READ;
+    expect_errno("SET_EVENTFD, закрытый fd", ioctl(fd, SCULL_RING_IOCTL_SET_EVENTFD, &req), EBADF);
+
+    close(other);
+}
+
+/**
+ * read() с заголовком записи в буфер ровно под заголовок
+ * Драйвер отказывает до захвата кольца, данные и счетчики не меняются.
+ */
+static void check_read_meta_short(int fd) {
+    struct scull_ring_rec_hdr hdr;
+    __u32 on = 1, off = 0;
+
+    if (ioctl(fd, SCULL_RING_IOCTL_SET_READ_META, &on) < 0) {
+        perror("SET_READ_META");
+        failures++;
+        return;
+    }
+    expect_errno("read() с READ_META в буфер размером с заголовок", (int)read(fd, &hdr, sizeof(hdr)), EINVAL);
+    ioctl(fd, SCULL_RING_IOCTL_SET_READ_META, &off);
+}
+
+/**
+ * Создание временного кольца для проверок, меняющих режим
+ * @flags: режим кольца
+ * @minor: выход - номер кольца
+ * Возвращает дескриптор кольца или -1 (нет CAP_SYS_ADMIN - проверка пропускается)
+ */
+static int scratch_open(unsigned int flags, unsigned int *minor) {
+    struct scull_ring_create req = { .minor = SCULL_RING_MINOR_ANY, .flags = flags };
+    char path[64];
+    int ctl, fd = -1;
+
+    ctl = open(DEV_CTL, O_RDWR);
+    if (ctl < 0) {
+        perror("open " DEV_CTL);
+        failures++;
+        return -1;
+    }
+    if (ioctl(ctl, SCULL_RING_IOCTL_CREATE, &req) < 0) {
+        if (errno == EPERM) {
+            printf("skip временное кольцо: нужен CAP_SYS_ADMIN (sudo ./p7)\n");
+        } else {
+            perror("SCULL_RING_IOCTL_CREATE");
+            failures++;
+        }
+        close(ctl);
+        return -1;
+    }
+    close(ctl);
+    *minor = req.minor;
+
+    // Узел создает udev, подождем его немного
+    snprintf(path, sizeof(path), "/dev/scull_ring%u", req.minor);
+    for (int i = 0; i < 50; i++) {
+        fd = open(path, O_RDWR);
+        if (fd >= 0 || errno != ENOENT) {
+            break;
+        }
+        usleep(20000);
+    }
+    if (fd < 0) {
+        perror(path);
+        failures++;
+    }
+    return fd;
+}
+
+/**
+ * Закрытие и удаление временного кольца
+ */
+static void scratch_close(int fd, unsigned int minor) {
+    int ctl;
+
+    close(fd);
+    ctl = open(DEV_CTL, O_RDWR);
+    if (ctl < 0 || ioctl(ctl, SCULL_RING_IOCTL_DESTROY, &minor) < 0) {
+        perror("SCULL_RING_IOCTL_DESTROY");
+        failures++;
+    }
+    if (ctl >= 0) {
+        close(ctl);
+    }
+}
+
+/**
+ * Порог read_msgs в режиме BROADCAST не поддерживается
+ * Ни SET_WATERMARK, ни переход в BROADCAST не должны его допускать.
+ */
+static void check_broadcast_read_msgs(void) {
+    struct scull_ring_watermark wm = { .read_bytes = 1, .read_msgs = 4, .write_bytes = 1 };
+    unsigned int flags;
+    unsigned int minor;
+    int fd;
+
+    fd = scratch_open(SCULL_RING_F_BROADCAST, &minor);
+    if (fd < 0) {
+        return;
+    }
+    expect_errno("SET_WATERMARK read_msgs в BROADCAST", ioctl(fd, SCULL_RING_IOCTL_SET_WATERMARK, &wm), EINVAL);
+
+    flags = 0;
+    if (ioctl(fd, SCULL_RING_IOCTL_SET_FLAGS, &flags) < 0 ||
+        ioctl(fd, SCULL_RING_IOCTL_SET_WATERMARK, &wm) < 0) {
+        perror("SET_FLAGS/SET_WATERMARK");
+        failures++;
+    } else {
+        flags = SCULL_RING_F_BROADCAST;
+        expect_errno("SET_FLAGS BROADCAST при read_msgs", ioctl(fd, SCULL_RING_IOCTL_SET_FLAGS, &flags), EINVAL);
+    }
+    scratch_close(fd, minor);
+}
+
+int main() {
+    int fd = open(DEV_SCULL0, O_RDWR);
+
+    if (fd < 0) {
+        perror("open " DEV_SCULL0);
+        return 1;
+    }
+
+    check_eventfd_not_eventfd(fd);
+    check_read_meta_short(fd);
+    check_broadcast_read_msgs();
+
+    close(fd);
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
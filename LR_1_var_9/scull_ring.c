@@ -11,52 +11,226 @@
 #include <linux/sched.h>
 #include <linux/ioctl.h>
 #include <linux/atomic.h>
+#include <linux/wait_bit.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/poll.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/miscdevice.h>
+#include <linux/kthread.h>
+#include <linux/sched/signal.h>
+#include <linux/completion.h>
+#include <linux/uio.h>
+#include <linux/eventfd.h>
+
+#include "scull_ring_ioctl.h"
+
+#define CREATE_TRACE_POINTS
+#include "scull_ring_trace.h"
 
 #define DEVICE_NAME "scull_ring"
-#define SCULL_RING_BUFFER_SIZE 256        // Размер каждого кольцевого буфера
-#define SCULL_RING_NR_DEVS 3              // Количество устройств: scull_ring0,1,2
+#define SCULL_RING_BUFFER_SIZE 256        // Размер кольцевого буфера по умолчанию (степень двойки)
+#define SCULL_RING_MIN_SIZE 64            // Минимальный размер буфера (вмещает заголовок записи)
+#define SCULL_RING_MAX_SIZE (64u << 20)   // Максимальный размер буфера (64 МБ)
+#define SCULL_RING_NR_DEVS 3              // Количество устройств при загрузке по умолчанию: scull_ring0,1,2
+#define SCULL_RING_MAX_DEVS 256           // Диапазон младших номеров (устройства добавляются через scull_ring_ctl)
+#define SCULL_RING_MARKS 64               // Отметок времени записи для гистограммы пребывания
+#define SCULL_RING_PEEK_BYTES PAGE_SIZE   // Сколько данных копирует снимок для PEEK_BUFFER
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Maxim_Panfilov"); 
 MODULE_DESCRIPTION("Scull Driver for LR1");
 
-// Структура кольцевого буфера с синхронизацией
+/*
+ * Состояние одной стороны кольца (читатели или писатели) для SPSC-режима.
+ * Пока на стороне работает ровно один процесс, он захватывает её через
+ * inflight и обходится без мьютекса; при конкуренции сторона переключается
+ * на buf->lock, а locked не дает новым процессам войти без блокировки.
+ */
+struct scull_ring_side {
+    atomic_t inflight;       // Количество операций стороны, выполняемых без мьютекса
+    atomic_t locked;         // Количество операций стороны, выполняемых под мьютексом
+    atomic_long_t contended; // Сколько раз сторона ушла на мьютекс из-за другого процесса
+};
+
+/*
+ * Отметка времени пачки записи: когда читатель сдвинет read_pos за pos,
+ * now - ns попадает в гистограмму времени пребывания.
+ */
+struct scull_ring_mark {
+    unsigned int pos;        // Позиция конца пачки
+    u64 ns;                  // Время записи пачки
+};
+
+/*
+ * Подкольцо одного процессора (режим SCULL_RING_F_PERCPU).
+ * Сообщения лежат как struct scull_ring_rec_hdr и данные, в seq -
+ * порядковый номер для слияния. Писатели, выполняющиеся на процессоре,
+ * берут мьютекс его подкольца - почти всегда без конкуренции, и разные
+ * процессоры не делят кэш-линий. Читатели работают под buf->lock.
+ */
+struct scull_ring_sub {
+    struct mutex lock;       // Писатели этого процессора
+    char *data;              // Данные (buf->size байт на узле процессора)
+    unsigned int write_pos;  // Позиция записи (публикуется с release)
+    unsigned long messages;  // Сообщений записано в подкольцо
+    unsigned long bytes;     // Байт данных записано в подкольцо
+    unsigned int read_pos ____cacheline_aligned_in_smp;  // Позиция чтения (пишет читатель)
+};
+
+/*
+ * Структура кольцевого буфера с синхронизацией.
+ *
+ * Поля разбиты на группы по кэш-линиям: настройки только читаются на
+ * горячем пути, а счетчики и состояние писателей и читателей лежат в
+ * разных линиях, чтобы стороны не вытесняли их друг у друга (сами позиции
+ * живут в управляющей странице, тоже в разных линиях).
+ */
 struct scull_ring_buffer {
-    char *data;              // Указатель на данные буфера
-    int size;                // Общий размер буфера
-    int read_pos;            // Текущая позиция чтения (голова)
-    int write_pos;           // Текущая позиция записи (хвост)
-    int data_len;            // Текущее количество данных в буфере
-    struct mutex lock;       // Мьютекс для защиты от гонок данных
-    wait_queue_head_t read_queue;   // Очередь ожидания для читателей (когда буфер пуст)
+    // Настройки кольца: меняются только под scull_ring_lock_all
+    int minor;               // Младший номер устройства (для трассировки)
+    struct scull_ring_ctrl *ctrl;  // Управляющая страница: позиции read_pos/write_pos (см. scull_ring_ioctl.h)
+    struct page *ctrl_page;  // Страница, на которой лежит ctrl
+    char *data;              // Указатель на данные буфера (vmap страниц данных)
+    unsigned int size;       // Общий размер буфера (степень двойки)
+    unsigned int mask;       // size - 1: индекс в данных равен pos & mask
+    unsigned int flags;      // Режим кольца SCULL_RING_F_* (меняется только под scull_ring_lock_all)
+    seqcount_mutex_t geom_seq;  // Смена data/size/flags и сброс позиций (для снимков без мьютекса)
+    int node;                // Узел NUMA для данных: номер, NUMA_NO_NODE или SCULL_RING_NODE_FIRST_WRITER
+    int data_node;           // Узел, на котором данные лежат сейчас (NUMA_NO_NODE - любой)
+    atomic_t placed;         // Данные уже перенесены к первому писателю
+    struct page **pages;     // Управляющая страница и страницы данных для mmap()
+    unsigned int nr_pages;   // Количество страниц в pages
+    atomic_t mmap_count;     // Количество действующих отображений кольца
+    struct scull_ring_watermark wm;  // Пороги пробуждения (поля читаются через READ_ONCE)
+    struct scull_ring_hist __percpu *hist;  // Гистограммы, свои на каждом процессоре
+    struct scull_ring_sub __percpu *subs;  // Подкольца процессоров (режим SCULL_RING_F_PERCPU)
+    struct dentry *debugfs;  // Каталог устройства в debugfs
+
+    // Общее состояние под мьютексом
+    struct mutex lock ____cacheline_aligned_in_smp;  // Мьютекс для защиты от гонок при нескольких читателях/писателях
+    struct mutex map_lock;   // Защищает pages от смены размера во время mmap()
+    struct list_head readers;  // Файлы, открытые на чтение (struct scull_ring_file, под lock)
+    unsigned int sub_next;   // Следующий процессор для обхода по кругу (под lock)
+    atomic_long_t dropped;   // Сообщения, затертые в режиме SCULL_RING_F_OVERWRITE
+
+    // Писатели
+    struct scull_ring_side wr ____cacheline_aligned_in_smp;  // Состояние стороны писателей
     wait_queue_head_t write_queue;  // Очередь ожидания для писателей (когда буфер полон)
-    atomic_t read_count;     // Атомарный счетчик операций чтения
     atomic_t write_count;    // Атомарный счетчик операций записи
+    atomic64_t write_bytes;  // Байт данных записано
+    atomic_long_t write_blocked;  // Сколько раз писатели засыпали на полном кольце
+    atomic_t seq;            // Порядковый номер записей (TIMESTAMP, MERGE)
+    unsigned int mark_head;  // Следующая отметка писателя
+
+    // Читатели
+    struct scull_ring_side rd ____cacheline_aligned_in_smp;  // Состояние стороны читателей
+    wait_queue_head_t read_queue;   // Очередь ожидания для читателей (когда буфер пуст)
+    atomic_t read_count;     // Атомарный счетчик операций чтения
+    atomic64_t read_bytes;   // Байт данных прочитано
+    atomic_long_t read_blocked;   // Сколько раз читатели засыпали на пустом кольце
+    unsigned int mark_tail;  // Следующая отметка читателя
+
+    // Очередь отметок (пишет писатель, снимает читатель)
+    struct scull_ring_mark marks[SCULL_RING_MARKS] ____cacheline_aligned_in_smp;
 };
 
 // Структура устройства
 struct scull_ring_dev {
     struct scull_ring_buffer *ring_buf;  // Указатель на кольцевой буфер
-    struct cdev cdev;                    // Структура символьного устройства
+    struct cdev *cdev;                   // Символьное устройство (cdev_alloc: живет, пока его держит open)
+    struct device *device;               // Узел /dev/scull_ringN
+    unsigned int users;                  // Открытые файлы (под scull_ring_devices_lock)
+};
+
+struct scull_ring_file;
+
+/*
+ * Дверной звонок файла (SCULL_RING_IOCTL_SET_EVENTFD): элемент очереди
+ * read_queue или write_queue, который вместо пробуждения процесса
+ * сигналит eventfd. Поэтому звонок срабатывает во всех местах, где кольцо
+ * будит спящих, с теми же порогами.
+ */
+struct scull_ring_doorbell {
+    struct wait_queue_entry wait;        // Элемент очереди (только пока ctx != NULL)
+    struct eventfd_ctx *ctx;             // eventfd процесса
+    struct scull_ring_file *rf;          // Файл звонка
+    bool write;                          // Звонок места (write_queue), иначе данных
 };
 
+// Состояние открытого файла (filp->private_data)
+struct scull_ring_file {
+    struct scull_ring_dev *dev;          // Устройство файла
+    struct list_head node;               // Элемент buf->readers после первого чтения (scull_ring_subscribe)
+    unsigned int cursor;                 // Собственная позиция чтения в режиме BROADCAST
+    unsigned long lapped;                // Сколько раз писатель обогнал этого читателя
+    unsigned int busy_poll_us;           // Сколько крутиться перед сном на пустом кольце
+    bool read_meta;                      // read() отдает заголовок записи перед данными
+    struct mutex splice_lock;            // Один splice() в файл за раз (scull_ring_splice_write)
+    struct task_struct *splice_task;     // Процесс внутри scull_ring_splice_write или NULL
+    struct scull_ring_doorbell read_bell;   // Звонок данных
+    struct scull_ring_doorbell write_bell;  // Звонок свободного места
+};
+
+// Формат кольца и протокол сторон (общие с user/scull_ring_user.c)
+#include "scull_ring_core.h"
+
 static int scull_ring_major = 0;         // Основной номер устройства (0 = автоназначение)
 module_param(scull_ring_major, int, S_IRUGO);
 
-// Массив устройств (3 устройства: scull_ring0, scull_ring1, scull_ring2)
-static struct scull_ring_dev scull_ring_devices[SCULL_RING_NR_DEVS];
+// Количество устройств, создаваемых при загрузке
+static unsigned int scull_ring_nr_devs = SCULL_RING_NR_DEVS;
+module_param(scull_ring_nr_devs, uint, S_IRUGO);
+MODULE_PARM_DESC(scull_ring_nr_devs, "Number of rings created at load time (more can be added via /dev/scull_ring_ctl)");
+
+// Начальный режим каждого устройства (SCULL_RING_F_*), например scull_ring_flags=1,0,1
+static unsigned int scull_ring_flags[SCULL_RING_MAX_DEVS];
+module_param_array(scull_ring_flags, uint, NULL, S_IRUGO);
+MODULE_PARM_DESC(scull_ring_flags, "Per-device ring mode (1 = length-prefixed records, 3 = records with timestamps, +4 = overwrite oldest, +8 = broadcast, +16 = per-CPU sub-rings, +32 = merge them in order, +64 = work queue with exclusive wakeups)");
+
+// Начальный размер каждого устройства, например scull_ring_sizes=4096,1048576,256
+static unsigned int scull_ring_sizes[SCULL_RING_MAX_DEVS] = {
+    [0 ... SCULL_RING_MAX_DEVS - 1] = SCULL_RING_BUFFER_SIZE
+};
+module_param_array(scull_ring_sizes, uint, NULL, S_IRUGO);
+MODULE_PARM_DESC(scull_ring_sizes, "Per-device ring size in bytes (power of two, 64 B .. 64 MiB)");
+
+// Узел NUMA для данных каждого устройства: -1 - любой, -2 - узел первого писателя
+static int scull_ring_nodes[SCULL_RING_MAX_DEVS] = {
+    [0 ... SCULL_RING_MAX_DEVS - 1] = NUMA_NO_NODE
+};
+module_param_array(scull_ring_nodes, int, NULL, S_IRUGO);
+MODULE_PARM_DESC(scull_ring_nodes, "Per-device NUMA node for ring data (-1 = any, -2 = node of the first writer)");
+
+// Таблица устройств по младшему номеру; NULL - номер свободен
+static struct scull_ring_dev *scull_ring_devices[SCULL_RING_MAX_DEVS];
+static DEFINE_MUTEX(scull_ring_devices_lock);  // Таблица, users и создание/удаление устройств
+
+// Класс устройств: узлы /dev/scull_ringN создаются через device_create
+static struct class *scull_ring_class;
 
-// Определения IOCTL команд для взаимодействия с пользовательским пространством
-#define SCULL_RING_IOCTL_GET_STATUS _IOR('s', 1, int[4])      // Получить статус буфера
-#define SCULL_RING_IOCTL_GET_COUNTERS _IOR('s', 2, long[2])   // Получить счетчики операций
-#define SCULL_RING_IOCTL_PEEK_BUFFER _IOWR('s', 10, char[512]) // Заглянуть в содержимое буфера
+// Корневой каталог драйвера в debugfs
+static struct dentry *scull_ring_debugfs;
 
 // Прототипы функций файловых операций
 static int scull_ring_open(struct inode *inode, struct file *filp);
 static int scull_ring_release(struct inode *inode, struct file *filp);
 static ssize_t scull_ring_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos);
 static ssize_t scull_ring_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
+static ssize_t scull_ring_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static ssize_t scull_ring_write_iter(struct kiocb *iocb, struct iov_iter *from);
+static ssize_t scull_ring_splice_write(struct pipe_inode_info *pipe, struct file *out, loff_t *ppos,
+                                       size_t len, unsigned int flags);
 static long scull_ring_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+static int scull_ring_mmap(struct file *filp, struct vm_area_struct *vma);
+static __poll_t scull_ring_poll(struct file *filp, poll_table *wait);
 
 // Структура файловых операций (точки входа драйвера)
 static struct file_operations scull_ring_fops = {
@@ -65,39 +239,289 @@ static struct file_operations scull_ring_fops = {
     .release = scull_ring_release,
     .read = scull_ring_read,
     .write = scull_ring_write,
+    .read_iter = scull_ring_read_iter,
+    .write_iter = scull_ring_write_iter,
     .unlocked_ioctl = scull_ring_ioctl,
+    .mmap = scull_ring_mmap,
+    .poll = scull_ring_poll,
+    // splice() идет через read_iter/write_iter: данные копируются между
+    // кольцом и страницами канала, минуя пользовательскую память
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+    .splice_read = copy_splice_read,
+#else
+    .splice_read = generic_file_splice_read,
+#endif
+    .splice_write = scull_ring_splice_write,
 };
 
+/**
+ * Проверка допустимости набора флагов режима
+ */
+static bool scull_ring_flags_valid(unsigned int flags) {
+    if (flags & ~(SCULL_RING_F_RECORD | SCULL_RING_F_TIMESTAMP | SCULL_RING_F_OVERWRITE |
+                  SCULL_RING_F_BROADCAST | SCULL_RING_F_PERCPU | SCULL_RING_F_MERGE |
+                  SCULL_RING_F_WORKQUEUE)) {
+        return false;
+    }
+    // Метку времени негде хранить без заголовка записи (в подкольцах он есть всегда)
+    if ((flags & SCULL_RING_F_TIMESTAMP) && !(flags & (SCULL_RING_F_RECORD | SCULL_RING_F_PERCPU))) {
+        return false;
+    }
+    // Сливать можно только подкольца; затирание и подписчики с ними не сочетаются
+    if ((flags & SCULL_RING_F_MERGE) && !(flags & SCULL_RING_F_PERCPU)) {
+        return false;
+    }
+    if ((flags & SCULL_RING_F_PERCPU) && (flags & (SCULL_RING_F_OVERWRITE | SCULL_RING_F_BROADCAST))) {
+        return false;
+    }
+    // Раздача работы противоположна рассылке: сообщение получает один читатель
+    if ((flags & SCULL_RING_F_WORKQUEUE) && (flags & SCULL_RING_F_BROADCAST)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Проверка допустимости размера кольца
+ * Размер - степень двойки, чтобы индекс вычислялся маской, а свободно
+ * растущие позиции корректно переполнялись.
+ */
+static bool scull_ring_size_valid(unsigned int size) {
+    return is_power_of_2(size) && size >= SCULL_RING_MIN_SIZE && size <= SCULL_RING_MAX_SIZE;
+}
+
+/**
+ * Проверка узла NUMA для данных кольца
+ * Допустимы узел с памятью, NUMA_NO_NODE и SCULL_RING_NODE_FIRST_WRITER.
+ */
+static bool scull_ring_node_valid(int node) {
+    if (node == NUMA_NO_NODE || node == SCULL_RING_NODE_FIRST_WRITER) {
+        return true;
+    }
+    return node >= 0 && node < MAX_NUMNODES && node_state(node, N_MEMORY);
+}
+
+/**
+ * Освобождение страниц данных кольца
+ * @pages: массив страниц (pages[0] - управляющая, не освобождается)
+ * @nr_pages: количество страниц в массиве
+ * @data: отображение страниц данных в ядре
+ */
+static void scull_ring_free_data(struct page **pages, unsigned int nr_pages, char *data) {
+    unsigned int i;
+
+    if (data) {
+        vunmap(data);
+    }
+    for (i = 1; i < nr_pages; i++) {
+        if (pages[i]) {
+            __free_page(pages[i]);
+        }
+    }
+    kvfree(pages);
+}
+
+/**
+ * Выделение страниц данных кольца
+ * @ctrl_page: управляющая страница, которая становится pages[0]
+ * @size: размер данных в байтах
+ * @node: узел NUMA для страниц (NUMA_NO_NODE - узел текущего процессора)
+ * @nr_pages: выход - количество страниц в массиве
+ * @data: выход - непрерывное отображение данных в ядре
+ * Возвращает массив страниц или NULL
+ *
+ * Данные выделяются постранично и склеиваются через vmap, поэтому кольцо
+ * может занимать мегабайты без поиска непрерывной физической памяти.
+ * Тот же массив целиком отдается процессу в mmap().
+ */
+static struct page **scull_ring_alloc_data(struct page *ctrl_page, unsigned int size, int node,
+                                           unsigned int *nr_pages, char **data) {
+    struct page **pages;
+    unsigned int n = 1 + (PAGE_ALIGN(size) >> PAGE_SHIFT);
+    unsigned int i;
+
+    pages = kvcalloc(n, sizeof(*pages), GFP_KERNEL);
+    if (!pages) {
+        return NULL;
+    }
+    pages[0] = ctrl_page;
+    for (i = 1; i < n; i++) {
+        pages[i] = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+        if (!pages[i]) {
+            scull_ring_free_data(pages, n, NULL);
+            return NULL;
+        }
+    }
+    *data = vmap(pages + 1, n - 1, VM_MAP, PAGE_KERNEL);
+    if (!*data) {
+        scull_ring_free_data(pages, n, NULL);
+        return NULL;
+    }
+    *nr_pages = n;
+    return pages;
+}
+
+/**
+ * Освобождение подколец процессоров
+ */
+static void scull_ring_subs_free(struct scull_ring_sub __percpu *subs) {
+    int cpu;
+
+    if (!subs) {
+        return;
+    }
+    for_each_possible_cpu(cpu) {
+        kvfree(per_cpu_ptr(subs, cpu)->data);
+    }
+    free_percpu(subs);
+}
+
+/**
+ * Выделение подколец процессоров (режим SCULL_RING_F_PERCPU)
+ * @size: размер каждого подкольца
+ * Возвращает подкольца или NULL
+ *
+ * Данные подкольца выделяются на узле NUMA его процессора: туда пишут
+ * только процессы, выполняющиеся на нем.
+ */
+static struct scull_ring_sub __percpu *scull_ring_subs_alloc(unsigned int size) {
+    struct scull_ring_sub __percpu *subs;
+    struct scull_ring_sub *sub;
+    int cpu;
+
+    subs = alloc_percpu(struct scull_ring_sub);
+    if (!subs) {
+        return NULL;
+    }
+    for_each_possible_cpu(cpu) {
+        sub = per_cpu_ptr(subs, cpu);
+        mutex_init(&sub->lock);
+        sub->data = kvmalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
+        if (!sub->data) {
+            scull_ring_subs_free(subs);
+            return NULL;
+        }
+    }
+    return subs;
+}
+
 /**
  * Инициализация кольцевого буфера
  * @buf: указатель на структуру буфера
- * @size: размер буфера в байтах
+ * @minor: младший номер устройства
+ * @size: размер буфера в байтах (степень двойки)
+ * @flags: режим кольца SCULL_RING_F_*
  * Возвращает 0 при успехе, отрицательный код ошибки при failure
+ *
+ * Память выделяется постранично: первая страница - управляющая
+ * (struct scull_ring_ctrl), за ней страницы данных. Страницы могут
+ * быть отданы процессу через mmap() без копирования.
  */
-static int scull_ring_buffer_init(struct scull_ring_buffer *buf, int size) {
-    // Выделение памяти под данные буфера в пространстве ядра
-    buf->data = kmalloc(size, GFP_KERNEL);
-    if (!buf->data) {
+static int scull_ring_buffer_init(struct scull_ring_buffer *buf, int minor, unsigned int size,
+                                  unsigned int flags, int node) {
+    if (!scull_ring_flags_valid(flags)) {
+        printk(KERN_ERR "scull_ring: Invalid ring flags 0x%x\n", flags);
+        return -EINVAL;
+    }
+    if (!scull_ring_size_valid(size)) {
+        printk(KERN_ERR "scull_ring: Invalid ring size %u (power of two, %u..%u)\n",
+               size, SCULL_RING_MIN_SIZE, SCULL_RING_MAX_SIZE);
+        return -EINVAL;
+    }
+
+    if (!scull_ring_node_valid(node)) {
+        printk(KERN_ERR "scull_ring: Invalid NUMA node %d\n", node);
+        return -EINVAL;
+    }
+    // До первой записи узел писателя неизвестен
+    buf->node = node;
+    buf->data_node = node >= 0 ? node : NUMA_NO_NODE;
+    atomic_set(&buf->placed, node != SCULL_RING_NODE_FIRST_WRITER);
+
+    // Управляющая страница живет все время жизни буфера, даже при смене размера
+    buf->ctrl_page = alloc_pages_node(buf->data_node, GFP_KERNEL | __GFP_ZERO, 0);
+    if (!buf->ctrl_page) {
+        printk(KERN_ERR "scull_ring: Failed to allocate buffer memory\n");
+        return -ENOMEM;
+    }
+    buf->ctrl = page_address(buf->ctrl_page);
+
+    // Выделение страниц под данные буфера
+    buf->pages = scull_ring_alloc_data(buf->ctrl_page, size, buf->data_node, &buf->nr_pages, &buf->data);
+    if (!buf->pages) {
+        printk(KERN_ERR "scull_ring: Failed to allocate buffer memory\n");
+        __free_page(buf->ctrl_page);
+        return -ENOMEM;
+    }
+
+    buf->hist = alloc_percpu(struct scull_ring_hist);
+    if (!buf->hist) {
         printk(KERN_ERR "scull_ring: Failed to allocate buffer memory\n");
+        scull_ring_free_data(buf->pages, buf->nr_pages, buf->data);
+        __free_page(buf->ctrl_page);
         return -ENOMEM;
     }
+    buf->mark_head = 0;
+    buf->mark_tail = 0;
+    buf->debugfs = NULL;
+
+    buf->subs = NULL;
+    if (flags & SCULL_RING_F_PERCPU) {
+        buf->subs = scull_ring_subs_alloc(size);
+        if (!buf->subs) {
+            printk(KERN_ERR "scull_ring: Failed to allocate per-CPU sub-rings\n");
+            free_percpu(buf->hist);
+            scull_ring_free_data(buf->pages, buf->nr_pages, buf->data);
+            __free_page(buf->ctrl_page);
+            return -ENOMEM;
+        }
+    }
+    buf->sub_next = 0;
+    atomic_set(&buf->seq, 0);
     
     // Инициализация полей структуры
+    buf->minor = minor;
     buf->size = size;
-    buf->read_pos = 0;
-    buf->write_pos = 0;
-    buf->data_len = 0;
+    buf->mask = size - 1;
+    buf->ctrl->read_pos = 0;
+    buf->ctrl->write_pos = 0;
+    buf->ctrl->version = SCULL_RING_CTRL_VERSION;
+    buf->ctrl->size = size;
+    buf->ctrl->data_offset = PAGE_SIZE;
+    buf->flags = flags;
+    buf->ctrl->flags = flags;
+    atomic_set(&buf->mmap_count, 0);
     
     // Инициализация механизмов синхронизации
     mutex_init(&buf->lock);                          // Инициализация мьютекса
+    mutex_init(&buf->map_lock);                      // Мьютекс отображений
+    seqcount_mutex_init(&buf->geom_seq, &buf->lock);
+    atomic_set(&buf->rd.inflight, 0);                // Сторона читателей свободна
+    atomic_set(&buf->rd.locked, 0);
+    atomic_set(&buf->wr.inflight, 0);                // Сторона писателей свободна
+    atomic_set(&buf->wr.locked, 0);
+    atomic_long_set(&buf->rd.contended, 0);
+    atomic_long_set(&buf->wr.contended, 0);
     init_waitqueue_head(&buf->read_queue);           // Очередь для читателей
     init_waitqueue_head(&buf->write_queue);          // Очередь для писателей
+    INIT_LIST_HEAD(&buf->readers);                   // Подписчики режима BROADCAST
     
     // Инициализация атомарных счетчиков
     atomic_set(&buf->read_count, 0);
     atomic_set(&buf->write_count, 0);
+    atomic64_set(&buf->read_bytes, 0);
+    atomic64_set(&buf->write_bytes, 0);
+    atomic_long_set(&buf->read_blocked, 0);
+    atomic_long_set(&buf->write_blocked, 0);
+    atomic_long_set(&buf->dropped, 0);
+
+    // Без порогов каждая операция будит другую сторону
+    buf->wm.read_bytes = 1;
+    buf->wm.read_msgs = 0;
+    buf->wm.write_bytes = 1;
+    buf->wm.timeout_ms = 0;
     
-    printk(KERN_INFO "scull_ring: Buffer initialized with size %d\n", size);
+    printk(KERN_INFO "scull_ring: Buffer %d initialized with size %u\n", minor, size);
     return 0;
 }
 
@@ -105,473 +529,3024 @@ static int scull_ring_buffer_init(struct scull_ring_buffer *buf, int size) {
  * Очистка буфера и освобождение ресурсов
  */
 static void scull_ring_buffer_cleanup(struct scull_ring_buffer *buf) {
-    kfree(buf->data);  // Освобождение памяти данных буфера
+    scull_ring_free_data(buf->pages, buf->nr_pages, buf->data);  // Освобождение страниц данных буфера
+    __free_page(buf->ctrl_page);
+    free_percpu(buf->hist);
+    scull_ring_subs_free(buf->subs);
     printk(KERN_INFO "scull_ring: Buffer cleanup completed\n");
 }
 
 /**
- * Поиск нуль-терминатора в кольцевом буфере
- * @buf: указатель на буфер
- * @start_pos: начальная позиция поиска
- * @max_len: максимальная длина поиска
- * Возвращает длину сообщения включая нуль-терминатор, или -1 если не найден
- * 
- * Эта функция необходима для обработки строк в кольцевом буфере, так как
- * сообщения разделяются нуль-терминаторами.
+ * Количество данных в буфере
+ * Позиции растут свободно и переполняются вместе, поэтому разность
+ * всегда дает заполненность, если размер буфера - степень двойки.
+ * Отдельное поле data_len не хранится: его изменяли бы обе стороны,
+ * и кэш-линия постоянно перескакивала бы между читателем и писателем.
  */
-static int find_null_terminator(struct scull_ring_buffer *buf, int start_pos, int max_len) {
-    int pos = start_pos;
-    int bytes_checked = 0;
-    
-    // Поиск нуль-терминатора в пределах max_len или доступных данных
-    while (bytes_checked < max_len && bytes_checked < buf->data_len) {
-        if (buf->data[pos] == '\0') {
-            return bytes_checked + 1; // Возвращаем длину включая нуль-терминатор
-        }
-        pos = (pos + 1) % buf->size;  // Циклическое перемещение по буферу
-        bytes_checked++;
-    }
-    return -1; // Нуль-терминатор не найден
+static inline unsigned int scull_ring_data_len(struct scull_ring_buffer *buf) {
+    return READ_ONCE(buf->ctrl->write_pos) - READ_ONCE(buf->ctrl->read_pos);
 }
 
 /**
- * Извлечение всех сообщений из буфера для отладки через IOCTL
- * @buf: указатель на буфер
- * @output: буфер для результата
- * @output_size: размер выходного буфера
- * Возвращает количество извлеченных сообщений
- * 
- * Функция используется командой PEEK_BUFFER для показа содержимого буфера
- * без извлечения данных (только чтение).
- */
-static int extract_messages(struct scull_ring_buffer *buf, char *output, int output_size) {
-    int pos = buf->read_pos;      // Начинаем с текущей позиции чтения
-    int bytes_processed = 0;
-    int message_count = 0;
-    int output_used = 0;
-    
-    // Если буфер пуст
-    if (buf->data_len == 0) {
-        snprintf(output, output_size, "Empty");
-        return 0;
-    }
-    
-    // Начало вывода в формате списка
-    output_used += snprintf(output + output_used, output_size - output_used, "[");
-    
-    // Извлечение всех полных сообщений из буфера
-    while (bytes_processed < buf->data_len && output_used < output_size - 20) {
-        // Поиск следующего сообщения (до нуль-терминатора)
-        int message_len = find_null_terminator(buf, pos, buf->data_len - bytes_processed);
-        if (message_len < 0) {
-            // Полное сообщение не найдено - остались только частичные данные
-            int remaining = buf->data_len - bytes_processed;
-            if (remaining > 0) {
-                // Можно добавить информацию о частичных данных, но закомментировано
-                /* output_used += snprintf(output + output_used, output_size - output_used, 
-                                      "partial:%dbytes", remaining); */
-            }
-            break;
-        }
-        
-        // Извлечение сообщения из кольцевого буфера
-        char message[20];
-        int msg_bytes_copied = 0;
-        for (int i = 0; i < message_len - 1 && i < 19; i++) {
-            message[i] = buf->data[(pos + i) % buf->size];
-            msg_bytes_copied++;
-            
-            // Защита от случайных нуль-терминаторов в середине сообщения
-            if (message[i] == '\0') break;
-        }
-        message[msg_bytes_copied] = '\0';
-        
-        // Добавление сообщения в выходной буфер с разделителями
-        if (message_count > 0) {
-            output_used += snprintf(output + output_used, output_size - output_used, ", ");
-        }
-        output_used += snprintf(output + output_used, output_size - output_used, "%s", message);
-        
-        // Переход к следующему сообщению
-        pos = (pos + message_len) % buf->size;
-        bytes_processed += message_len;
-        message_count++;
-    }
-    
-    // Завершение форматированного вывода
-    output_used += snprintf(output + output_used, output_size - output_used, "]");
-    
-    // Информация о непоместившихся данных
-    if (bytes_processed < buf->data_len) {
-        output_used += snprintf(output + output_used, output_size - output_used, 
-                              " +%db more", buf->data_len - bytes_processed);
-    }
-    
-    return message_count;
+ * Количество данных в подкольце процессора (с заголовками)
+ */
+static inline unsigned int scull_ring_sub_len(struct scull_ring_sub *sub) {
+    return READ_ONCE(sub->write_pos) - READ_ONCE(sub->read_pos);
 }
 
 /**
- * Операция чтения из кольцевого буфера
- * @buf: указатель на буфер
- * @user_buf: буфер пользовательского пространства
- * @count: запрошенное количество байт
- * Возвращает количество прочитанных байт или код ошибки
- * 
- * Реализует блокирующее чтение: если данных нет, процесс блокируется
- * до появления данных или получения сигнала.
+ * Количество данных во всех подкольцах (режим SCULL_RING_F_PERCPU)
  */
-static int scull_ring_buffer_read(struct scull_ring_buffer *buf, char __user *user_buf, size_t count) {
-    int bytes_read = 0;
-    int available;
-    int to_end;
-    int message_len;
-
-    // Логирование начала операции чтения
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) attempting to read from buffer\n", 
-           current->comm, current->pid);
+static unsigned int scull_ring_subs_len(struct scull_ring_buffer *buf) {
+    unsigned int len = 0;
+    int cpu;
 
-    // Захват мьютекса с возможностью прерывания
-    if (mutex_lock_interruptible(&buf->lock)) {
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for mutex lock (READ)\n", 
-               current->comm, current->pid);
-        return -ERESTARTSYS;
+    for_each_possible_cpu(cpu) {
+        len += scull_ring_sub_len(per_cpu_ptr(buf->subs, cpu));
     }
+    return len;
+}
 
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) acquired mutex lock for reading\n", 
-           current->comm, current->pid);
+/**
+ * Записи подколец процессоров (режим SCULL_RING_F_PERCPU)
+ * @bytes: выход - байт записано (может быть NULL)
+ * Возвращает сообщений записано. Писатели подколец считают каждый в своем
+ * подкольце, сумма снимается без блокировок.
+ */
+static unsigned long scull_ring_sub_messages(struct scull_ring_buffer *buf, u64 *bytes) {
+    struct scull_ring_sub *sub;
+    unsigned long messages = 0;
+    int cpu;
 
-    // БЛОКИРОВКА 1: Читатель ждет данных (буфер пустой)
-    while (buf->data_len == 0) {
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) BLOCKED - buffer empty, waiting for data (data_len=0)\n", 
-               current->comm, current->pid);
-        
-        // Освобождаем мьютекс перед блокировкой (чтобы писатели могли работать)
-        mutex_unlock(&buf->lock);
-        
-        // Блокировка в очереди ожидания до появления данных
-        if (wait_event_interruptible(buf->read_queue, (buf->data_len > 0))) {
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for data\n", 
-                   current->comm, current->pid);
-            return -ERESTARTSYS;
-        }
-        
-        // Повторный захват мьютекса после пробуждения
-        if (mutex_lock_interruptible(&buf->lock)) {
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while re-acquiring mutex after wait\n", 
-                   current->comm, current->pid);
-            return -ERESTARTSYS;
-        }
-        
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) UNBLOCKED - data available (data_len=%d)\n", 
-               current->comm, current->pid, buf->data_len);
+    if (bytes) {
+        *bytes = 0;
     }
-
-    // Поиск полного сообщения (до нуль-терминатора)
-    message_len = find_null_terminator(buf, buf->read_pos, buf->data_len);
-    if (message_len < 0) {
-        // Полное сообщение не найдено - читаем доступные данные
-        message_len = (count < buf->data_len) ? count : buf->data_len;
-    } else {
-        // Найдено полное сообщение - ограничиваем чтение его длиной
-        if (message_len > count) {
-            message_len = count;
+    if (!(buf->flags & SCULL_RING_F_PERCPU)) {
+        return 0;
+    }
+    for_each_possible_cpu(cpu) {
+        sub = per_cpu_ptr(buf->subs, cpu);
+        messages += READ_ONCE(sub->messages);
+        if (bytes) {
+            *bytes += READ_ONCE(sub->bytes);
         }
     }
+    return messages;
+}
 
-    // Проверка доступных данных
-    available = buf->data_len;
-    if (message_len > available) {
-        message_len = available;
+/**
+ * Количество данных, непрочитанных данным файлом
+ * @rf: файл читателя или NULL (писатель - считать по общей позиции)
+ * В режиме BROADCAST у каждого файла своя позиция; у подписчика, которого
+ * обогнали, результат больше заполненности кольца. В режиме PERCPU
+ * считаются все подкольца.
+ */
+static inline unsigned int scull_ring_pending(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    if (buf->flags & SCULL_RING_F_PERCPU) {
+        return scull_ring_subs_len(buf);
     }
-
-    // Копирование данных из кольцевого буфера в пользовательское пространство
-    // Обработка случая, когда данные пересекают границу буфера
-    to_end = buf->size - buf->read_pos;
-    if (message_len > to_end) {
-        // Две операции копирования: от read_pos до конца и с начала буфера
-        if (copy_to_user(user_buf, buf->data + buf->read_pos, to_end)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
-        if (copy_to_user(user_buf + to_end, buf->data, message_len - to_end)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
-    } else {
-        // Одна операция копирования
-        if (copy_to_user(user_buf, buf->data + buf->read_pos, message_len)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
+    // Еще не подписанный файл (только ioctl/poll) видит общую позицию
+    if (rf && (buf->flags & SCULL_RING_F_BROADCAST) && !list_empty(&rf->node)) {
+        return READ_ONCE(buf->ctrl->write_pos) - READ_ONCE(rf->cursor);
     }
+    return scull_ring_data_len(buf);
+}
 
-    // Обновление позиции чтения и количества данных
-    buf->read_pos = (buf->read_pos + message_len) % buf->size;
-    buf->data_len -= message_len;
-    bytes_read = message_len;
+/**
+ * Сдвиг общей позиции чтения к самому отстающему подписчику (BROADCAST)
+ * Вызывается под buf->lock. Подписчик, которого обогнал писатель в режиме
+ * OVERWRITE, место не удерживает. Без подписчиков данные ждут первого.
+ * Возвращает новую позицию чтения
+ */
+static unsigned int scull_ring_broadcast_advance(struct scull_ring_buffer *buf) {
+    unsigned int write_pos = buf->ctrl->write_pos;
+    unsigned int read_pos = buf->ctrl->read_pos;
+    unsigned int lag, max_lag = 0;
+    struct scull_ring_file *rf;
 
-    // Увеличение счетчика операций чтения
-    atomic_inc(&buf->read_count);
-    
-    // Пробуждение ожидающих писателей (появилось свободное место)
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) read %d bytes, waking up writers (new data_len=%d)\n", 
-           current->comm, current->pid, bytes_read, buf->data_len);
-    
-    wake_up_interruptible(&buf->write_queue);
-    mutex_unlock(&buf->lock);
-    
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) released mutex after reading\n", 
-           current->comm, current->pid);
-    return bytes_read;
+    if (list_empty(&buf->readers)) {
+        return read_pos;
+    }
+    list_for_each_entry(rf, &buf->readers, node) {
+        lag = min(write_pos - rf->cursor, write_pos - read_pos);
+        max_lag = max(max_lag, lag);
+    }
+    read_pos = write_pos - max_lag;
+    smp_store_release(&buf->ctrl->read_pos, read_pos);
+    return read_pos;
 }
 
 /**
- * Операция записи в кольцевой буфер
- * @buf: указатель на буфер
- * @user_buf: буфер пользовательского пространства с данными
- * @count: количество байт для записи
- * Возвращает количество записанных байт или код ошибки
- * 
- * Реализует блокирующую запись: если буфер полон, процесс блокируется
- * до освобождения места или получения сигнала.
+ * Перенос позиций всех подписчиков на общую позицию чтения
+ * Вызывается под scull_ring_lock_all при смене режима или размера.
  */
-static int scull_ring_buffer_write(struct scull_ring_buffer *buf, const char __user *user_buf, size_t count) {
-    int bytes_written = 0;
-    int available;
-    int to_end;
+static void scull_ring_reset_cursors(struct scull_ring_buffer *buf) {
+    struct scull_ring_file *rf;
 
-    // Логирование начала операции записи
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) attempting to write %zu bytes to buffer\n", 
-           current->comm, current->pid, count);
+    list_for_each_entry(rf, &buf->readers, node) {
+        rf->cursor = buf->ctrl->read_pos;
+    }
+}
 
-    // Захват мьютекса с возможностью прерывания
+/**
+ * Подписка читателя на кольцо (первое чтение, звонок данных)
+ * @buf: указатель на буфер
+ * @rf: читатель; повторная подписка ничего не делает
+ * Возвращает 0 или -ERESTARTSYS
+ *
+ * Подписчиком файл становится не при open(), а когда начинает читать:
+ * дескриптор, через который только вызывают ioctl, poll или mmap
+ * (монитор p4), в режиме BROADCAST не держит место в кольце. Новый
+ * подписчик начинает с самого старого сообщения.
+ */
+static int scull_ring_subscribe(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    if (!list_empty(&rf->node)) {
+        return 0;
+    }
     if (mutex_lock_interruptible(&buf->lock)) {
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for mutex lock (WRITE)\n", 
-               current->comm, current->pid);
         return -ERESTARTSYS;
     }
-
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) acquired mutex lock for writing\n", 
-           current->comm, current->pid);
-
-    // БЛОКИРОВКА 2: Писатель ждет места (буфер полный)
-    while (buf->data_len == buf->size) {
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) BLOCKED - buffer full, waiting for space (data_len=%d, size=%d)\n", 
-               current->comm, current->pid, buf->data_len, buf->size);
-        
-        // Освобождение мьютекса перед блокировкой (чтобы читатели могли освободить место)
-        mutex_unlock(&buf->lock);
-        
-        // Блокировка в очереди ожидания до появления свободного места
-        if (wait_event_interruptible(buf->write_queue, (buf->data_len < buf->size))) {
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for buffer space\n", 
-                   current->comm, current->pid);
-            return -ERESTARTSYS;
-        }
-        
-        // Повторный захват мьютекса после пробуждения
-        if (mutex_lock_interruptible(&buf->lock)) {
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while re-acquiring mutex after wait\n", 
-                   current->comm, current->pid);
-            return -ERESTARTSYS;
-        }
-        
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) UNBLOCKED - space available (data_len=%d)\n", 
-               current->comm, current->pid, buf->data_len);
+    // Файл могли подписать параллельно из другого потока
+    if (list_empty(&rf->node)) {
+        rf->cursor = buf->ctrl->read_pos;
+        list_add_tail(&rf->node, &buf->readers);
     }
+    mutex_unlock(&buf->lock);
+    return 0;
+}
 
-    // Расчет доступного места для записи
-    available = buf->size - buf->data_len;
-    if (count > available) {
-        // Усечение записи если запрашивается больше чем доступно
-        count = available;
-        printk(KERN_INFO "scull_ring: Process %s (pid %d) write truncated to %zu bytes (buffer almost full)\n", 
-               current->comm, current->pid, count);
+/**
+ * Отписка читателя от кольца (закрытие файла, конец бенчмарка)
+ * @buf: указатель на буфер
+ * @rf: читатель; если он не подписан, ничего не делается
+ */
+static void scull_ring_unsubscribe(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    if (list_empty(&rf->node)) {
+        return;
     }
-
-    // Копирование данных из пользовательского пространства в кольцевой буфер
-    // Обработка случая, когда запись пересекает границу буфера
-    to_end = buf->size - buf->write_pos;
-    if (count > to_end) {
-        // Две операции копирования: от write_pos до конца и с начала буфера
-        if (copy_from_user(buf->data + buf->write_pos, user_buf, to_end)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
-        if (copy_from_user(buf->data, user_buf + to_end, count - to_end)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
-    } else {
-        // Одна операция копирования
-        if (copy_from_user(buf->data + buf->write_pos, user_buf, count)) {
-            mutex_unlock(&buf->lock);
-            return -EFAULT;
-        }
+    mutex_lock(&buf->lock);
+    list_del_init(&rf->node);
+    // Ушедший подписчик мог быть самым отстающим
+    if (buf->flags & SCULL_RING_F_BROADCAST) {
+        scull_ring_broadcast_advance(buf);
     }
-
-    // Обновление позиции записи и количества данных
-    buf->write_pos = (buf->write_pos + count) % buf->size;
-    buf->data_len += count;
-    bytes_written = count;
-
-    // Увеличение счетчика операций записи
-    atomic_inc(&buf->write_count);
-    
-    // Пробуждение ожидающих читателей (появились новые данные)
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) wrote %d bytes, waking up readers (new data_len=%d)\n", 
-           current->comm, current->pid, bytes_written, buf->data_len);
-    
-    wake_up_interruptible(&buf->read_queue);
     mutex_unlock(&buf->lock);
-    
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) released mutex after writing\n", 
-           current->comm, current->pid);
-    return bytes_written;
+    wake_up_interruptible_poll(&buf->write_queue, EPOLLOUT | EPOLLWRNORM);
 }
 
 /**
- * Операция открытия устройства
+ * Изменение счетчика спящих в управляющей странице
+ * Поле лежит в странице, отображаемой в пользовательское пространство,
+ * поэтому объявлено как __u32, а изменяется как atomic_t. Барьер после
+ * изменения парный к барьеру процесса, который сдвигает позицию через
+ * mmap() и затем проверяет счетчик.
  */
-static int scull_ring_open(struct inode *inode, struct file *filp) {
-    struct scull_ring_dev *dev;
-    
-    // Получение структуры устройства из inode
-    dev = container_of(inode->i_cdev, struct scull_ring_dev, cdev);
-    filp->private_data = dev;  // Сохранение для использования в других операциях
-    
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) opened device\n", 
-           current->comm, current->pid);
-    return 0;
+static inline void scull_ring_waiters_add(__u32 *waiters, int delta) {
+    atomic_add(delta, (atomic_t *)waiters);
+    smp_mb__after_atomic();
 }
 
 /**
- * Операция закрытия устройства
+ * Учет значения в гистограмме
+ * Счетчики свои у каждого процессора, поэтому читатель и писатель не
+ * делят кэш-линии; суммирование - в scull_ring_hist_sum.
  */
-static int scull_ring_release(struct inode *inode, struct file *filp) {
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) closed device\n", 
-           current->comm, current->pid);
-    return 0;
+static inline void scull_ring_hist_add(struct scull_ring_buffer *buf, int id, u64 value) {
+    unsigned int bucket = min_t(unsigned int, fls64(value), SCULL_RING_HIST_BUCKETS - 1);
+
+    this_cpu_inc(buf->hist->buckets[id][bucket]);
 }
 
 /**
- * Файловая операция read - точка входа из пользовательского пространства
+ * Сумма гистограмм по всем процессорам
  */
-static ssize_t scull_ring_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos) {
-    struct scull_ring_dev *dev = filp->private_data;
-    return scull_ring_buffer_read(dev->ring_buf, buf, count);
+static void scull_ring_hist_sum(struct scull_ring_buffer *buf, struct scull_ring_hist *out) {
+    struct scull_ring_hist *hist;
+    int cpu, id, i;
+
+    memset(out, 0, sizeof(*out));
+    for_each_possible_cpu(cpu) {
+        hist = per_cpu_ptr(buf->hist, cpu);
+        for (id = 0; id < SCULL_RING_HIST_NR; id++) {
+            for (i = 0; i < SCULL_RING_HIST_BUCKETS; i++) {
+                out->buckets[id][i] += READ_ONCE(hist->buckets[id][i]);
+            }
+        }
+    }
 }
 
 /**
- * Файловая операция write - точка входа из пользовательского пространства
+ * Отметка времени пачки, записанной до write_pos
+ * Вызывается писателем до публикации write_pos. Если читатель отстал на
+ * SCULL_RING_MARKS пачек, пачка остается без отметки.
  */
-static ssize_t scull_ring_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos) {
-    struct scull_ring_dev *dev = filp->private_data;
-    return scull_ring_buffer_write(dev->ring_buf, buf, count);
+static void scull_ring_mark_write(struct scull_ring_buffer *buf, unsigned int write_pos) {
+    unsigned int head = buf->mark_head;
+    struct scull_ring_mark *mark;
+
+    if (head - smp_load_acquire(&buf->mark_tail) >= SCULL_RING_MARKS) {
+        return;
+    }
+    mark = &buf->marks[head % SCULL_RING_MARKS];
+    mark->pos = write_pos;
+    mark->ns = ktime_get_ns();
+    smp_store_release(&buf->mark_head, head + 1);
 }
 
 /**
- * IOCTL операции для управления и мониторинга устройства
- * @filp: файловая структура
- * @cmd: команда IOCTL
- * @arg: аргумент команды (указатель в пользовательском пространстве)
- * 
- * Поддерживаемые команды:
- * - GET_STATUS: получение статуса буфера (размер, заполненность)
- * - GET_COUNTERS: получение счетчиков операций чтения/записи
- * - PEEK_BUFFER: просмотр содержимого буфера без извлечения
+ * Снятие отметок пачек, прочитанных целиком до read_pos
  */
-static long scull_ring_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
-    struct scull_ring_dev *dev = filp->private_data;
-    struct scull_ring_buffer *buf = dev->ring_buf;
-    int status[4];
-    long counters[2];
-    char peek_buffer[512];
-    int message_count;
+static void scull_ring_mark_read(struct scull_ring_buffer *buf, unsigned int read_pos) {
+    unsigned int tail = buf->mark_tail;
+    unsigned int head = smp_load_acquire(&buf->mark_head);
+    struct scull_ring_mark *mark;
+    u64 now;
 
-    printk(KERN_INFO "scull_ring: Process %s (pid %d) calling ioctl cmd=%u\n", 
-           current->comm, current->pid, cmd);
+    if (tail == head) {
+        return;
+    }
+    now = ktime_get_ns();
+    while (tail != head) {
+        mark = &buf->marks[tail % SCULL_RING_MARKS];
+        if ((int)(mark->pos - read_pos) > 0) {
+            break;
+        }
+        scull_ring_hist_add(buf, SCULL_RING_HIST_RESIDENCY, now - mark->ns);
+        tail++;
+    }
+    smp_store_release(&buf->mark_tail, tail);
+}
 
-    switch (cmd) {
-        case SCULL_RING_IOCTL_GET_STATUS:
-            // Безопасное получение статуса буфера под мьютексом
-            if (mutex_lock_interruptible(&buf->lock)) {
-                printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for mutex lock (IOCTL STATUS)\n", 
-                       current->comm, current->pid);
-                return -ERESTARTSYS;
-            }
-            status[0] = buf->data_len;  // Текущее количество данных
-            status[1] = buf->size;      // Общий размер буфера
-            status[2] = 0;              // Зарезервировано
-            status[3] = 0;              // Зарезервировано
-            mutex_unlock(&buf->lock);
+/**
+ * Сколько записанных сообщений еще не прочитано (для порога read_msgs)
+ * Писатели подколец (PERCPU, MERGE) не трогают общий write_count - их
+ * сообщения считаются в подкольцах, как в GET_STATS.
+ */
+static unsigned int scull_ring_backlog_msgs(struct scull_ring_buffer *buf) {
+    unsigned int written = atomic_read(&buf->write_count);
 
-            // Копирование результатов в пользовательское пространство
-            if (copy_to_user((int __user *)arg, status, sizeof(status))) {
-                return -EFAULT;
+    written += scull_ring_sub_messages(buf, NULL);
+    return written - atomic_read(&buf->read_count);
+}
+
+/**
+ * Достаточно ли данных, чтобы будить читателей
+ * Данные есть и набран порог read_bytes или read_msgs. Если писатель
+ * спит, новых данных до чтения не будет - отдаем неполную пачку.
+ */
+static bool scull_ring_readable(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    unsigned int data_len = scull_ring_pending(buf, rf);
+    unsigned int msgs = READ_ONCE(buf->wm.read_msgs);
+
+    if (data_len == 0) {
+        return false;
+    }
+    if (data_len >= READ_ONCE(buf->wm.read_bytes)) {
+        return true;
+    }
+    // SET_WATERMARK и SET_FLAGS не сочетают read_msgs с BROADCAST, но
+    // они не упорядочены между собой - гонка не должна будить всех
+    if (msgs && !(buf->flags & SCULL_RING_F_BROADCAST) && scull_ring_backlog_msgs(buf) >= msgs) {
+        return true;
+    }
+    return READ_ONCE(buf->ctrl->write_waiters) != 0;
+}
+
+/**
+ * Достаточно ли свободного места, чтобы будить писателей
+ * @need: сколько нужно писателю (0 - только порог write_bytes)
+ * Порог ограничен размером кольца: после уменьшения кольца он мог стать
+ * недостижимым. В режиме PERCPU проверяется подкольцо процессора, на
+ * котором выполняется писатель.
+ */
+static bool scull_ring_writable(struct scull_ring_buffer *buf, unsigned int need) {
+    unsigned int space;
+
+    if (buf->flags & SCULL_RING_F_PERCPU) {
+        space = buf->size - scull_ring_sub_len(raw_cpu_ptr(buf->subs));
+    } else {
+        space = buf->size - scull_ring_data_len(buf);
+    }
+
+    return space >= need && space >= min(READ_ONCE(buf->wm.write_bytes), buf->size);
+}
+
+/**
+ * Исключительное ожидание данных (режим SCULL_RING_F_WORKQUEUE)
+ * @timeout: предельное время сна в jiffies или MAX_SCHEDULE_TIMEOUT
+ * Возвращает остаток времени (> 0), 0 по тайм-ауту или -ERESTARTSYS
+ *
+ * Процесс встает в очередь с WQ_FLAG_EXCLUSIVE, поэтому одно пробуждение
+ * поднимает одного свободного потребителя, а не всех. Если разбуженный
+ * процесс уходит по сигналу, пробуждение передается следующему, иначе
+ * сообщение осталось бы без потребителя.
+ */
+static long scull_ring_wait_exclusive(struct scull_ring_buffer *buf, struct scull_ring_file *rf, long timeout) {
+    DEFINE_WAIT(wait);
+    long ret;
+
+    for (;;) {
+        prepare_to_wait_exclusive(&buf->read_queue, &wait, TASK_INTERRUPTIBLE);
+        if (scull_ring_readable(buf, rf)) {
+            ret = max(timeout, 1L);
+            break;
+        }
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        if (!timeout) {
+            ret = 0;
+            break;
+        }
+        timeout = schedule_timeout(timeout);
+    }
+    finish_wait(&buf->read_queue, &wait);
+
+    if (ret < 0 && scull_ring_pending(buf, rf) > 0) {
+        wake_up_interruptible_poll(&buf->read_queue, EPOLLIN | EPOLLRDNORM);
+    }
+    return ret;
+}
+
+/**
+ * Активное ожидание данных перед сном (SCULL_RING_IOCTL_SET_BUSY_POLL)
+ * Возвращает true, если данные появились за rf->busy_poll_us
+ *
+ * Когда сообщения идут с интервалом в микросекунды, сон и пробуждение
+ * через очередь стоят дороже самой паузы. Цикл не держит блокировок и
+ * прерывается сигналом или запросом на перепланирование.
+ */
+static bool scull_ring_busy_poll(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    unsigned int us = rf ? READ_ONCE(rf->busy_poll_us) : 0;
+    u64 end;
+
+    if (!us) {
+        return false;
+    }
+    end = local_clock() + (u64)us * NSEC_PER_USEC;
+    do {
+        if (scull_ring_pending(buf, rf) > 0) {
+            return true;
+        }
+        cpu_relax();
+    } while (!need_resched() && !signal_pending(current) && local_clock() < end);
+
+    return scull_ring_pending(buf, rf) > 0;
+}
+
+/**
+ * Ожидание данных в кольце
+ * @rf: файл читателя (в режиме BROADCAST ждет своих непрочитанных данных)
+ * Возвращает 0 или -ERESTARTSYS при получении сигнала
+ *
+ * С тайм-аутом читатель раз в timeout_ms проверяет, не появилось ли
+ * хоть что-то, и забирает неполную пачку. В режиме WORKQUEUE читатели
+ * ждут исключительно. Если у файла задан бюджет активного ожидания,
+ * сначала крутимся, а в очередь встаем, только если данных так и нет.
+ */
+static int scull_ring_wait_readable(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    unsigned int timeout = READ_ONCE(buf->wm.timeout_ms);
+    bool exclusive = buf->flags & SCULL_RING_F_WORKQUEUE;
+    u64 start = ktime_get_ns();
+    long left;
+    int ret;
+
+    if (scull_ring_busy_poll(buf, rf)) {
+        return 0;
+    }
+
+    atomic_long_inc(&buf->read_blocked);
+    scull_ring_waiters_add(&buf->ctrl->read_waiters, 1);
+    if (!timeout && !exclusive) {
+        ret = wait_event_interruptible(buf->read_queue, scull_ring_readable(buf, rf));
+    } else {
+        for (;;) {
+            if (exclusive) {
+                left = scull_ring_wait_exclusive(buf, rf, timeout ? msecs_to_jiffies(timeout)
+                                                                  : MAX_SCHEDULE_TIMEOUT);
+            } else {
+                left = wait_event_interruptible_timeout(buf->read_queue, scull_ring_readable(buf, rf),
+                                                        msecs_to_jiffies(timeout));
+            }
+            if (left < 0) {
+                ret = left;
+                break;
+            }
+            if (left > 0 || scull_ring_pending(buf, rf) > 0) {
+                ret = 0;
+                break;
+            }
+        }
+    }
+    scull_ring_waiters_add(&buf->ctrl->read_waiters, -1);
+    scull_ring_hist_add(buf, SCULL_RING_HIST_READ_SLEEP, ktime_get_ns() - start);
+    return ret;
+}
+
+/**
+ * Ожидание свободного места в кольце
+ * @need: сколько байт должно освободиться (1..size)
+ * Возвращает 0 или -ERESTARTSYS при получении сигнала
+ */
+static int scull_ring_wait_writable(struct scull_ring_buffer *buf, unsigned int need) {
+    u64 start = ktime_get_ns();
+    int ret;
+
+    atomic_long_inc(&buf->write_blocked);
+    scull_ring_waiters_add(&buf->ctrl->write_waiters, 1);
+    // Читатели с порогом ждут полной пачки, а ее не будет, пока мы спим -
+    // будим их забрать то, что есть (барьер уже выполнен в waiters_add)
+    if (wq_has_sleeper(&buf->read_queue)) {
+        wake_up_interruptible_poll(&buf->read_queue, EPOLLIN | EPOLLRDNORM);
+    }
+    // need > size возможно после уменьшения кольца - писатель перепроверит запись
+    ret = wait_event_interruptible(buf->write_queue,
+                                   scull_ring_writable(buf, need) || need > buf->size);
+    scull_ring_waiters_add(&buf->ctrl->write_waiters, -1);
+    scull_ring_hist_add(buf, SCULL_RING_HIST_WRITE_SLEEP, ktime_get_ns() - start);
+    return ret;
+}
+
+/**
+ * Срабатывание звонка (функция элемента очереди, под ее спинлоком)
+ * Возвращает 0: звонок не считается разбуженным исключительным ожидающим,
+ * и в режиме WORKQUEUE пробуждение все равно достается потребителю.
+ *
+ * Места пробуждения уже проверили пороги для всех спящих; здесь условие
+ * перепроверяется для этого файла (своя позиция в режиме BROADCAST) и
+ * отсекает общие пробуждения вроде NOTIFY на пустом кольце.
+ */
+static int scull_ring_doorbell_wake(struct wait_queue_entry *wait, unsigned int mode, int sync, void *key) {
+    struct scull_ring_doorbell *bell = container_of(wait, struct scull_ring_doorbell, wait);
+    struct scull_ring_buffer *buf = bell->rf->dev->ring_buf;
+    bool ready;
+
+    if (bell->write) {
+        // В режиме PERCPU место зависит от процессора писателя, которого
+        // здесь нет, - звонок идет на каждое освобождение
+        ready = (buf->flags & SCULL_RING_F_PERCPU) || scull_ring_writable(buf, 0);
+    } else {
+        ready = scull_ring_readable(buf, bell->rf);
+    }
+    if (ready) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+        eventfd_signal(bell->ctx);
+#else
+        eventfd_signal(bell->ctx, 1);
+#endif
+    }
+    return 0;
+}
+
+/**
+ * Установка или снятие звонка файла (под buf->lock)
+ * @rf: файл
+ * @write: звонок места, иначе данных
+ * @ctx: новый eventfd (ссылка переходит звонку) или NULL - снять
+ *
+ * Звонок данных учитывается в ctrl->read_waiters, чтобы писатель через
+ * mmap() вызывал NOTIFY. Если условие уже выполнено, звонок срабатывает
+ * сразу: иначе данные, пришедшие до регистрации, остались бы без сигнала.
+ */
+static void scull_ring_doorbell_set(struct scull_ring_buffer *buf, struct scull_ring_file *rf,
+                                    bool write, struct eventfd_ctx *ctx) {
+    struct scull_ring_doorbell *bell = write ? &rf->write_bell : &rf->read_bell;
+    wait_queue_head_t *queue = write ? &buf->write_queue : &buf->read_queue;
+
+    if (bell->ctx) {
+        // После remove_wait_queue срабатывание на другом процессоре уже закончилось
+        remove_wait_queue(queue, &bell->wait);
+        if (!write) {
+            scull_ring_waiters_add(&buf->ctrl->read_waiters, -1);
+        }
+        eventfd_ctx_put(bell->ctx);
+        bell->ctx = NULL;
+    }
+    if (!ctx) {
+        return;
+    }
+
+    bell->ctx = ctx;
+    bell->rf = rf;
+    bell->write = write;
+    init_waitqueue_func_entry(&bell->wait, scull_ring_doorbell_wake);
+    add_wait_queue(queue, &bell->wait);
+    if (!write) {
+        scull_ring_waiters_add(&buf->ctrl->read_waiters, 1);
+    }
+    scull_ring_doorbell_wake(&bell->wait, 0, 0, NULL);
+}
+
+/**
+ * Команда SET_EVENTFD: звонки этого файла
+ * @buf: указатель на буфер
+ * @rf: файл
+ * @mode: режим открытия файла
+ * @arg: struct scull_ring_eventfd в пользовательском пространстве
+ * Возвращает 0 или код ошибки
+ *
+ * Звонок данных - заявка на чтение, поэтому он подписывает файл, как
+ * первый read().
+ */
+static int scull_ring_ioctl_eventfd(struct scull_ring_buffer *buf, struct scull_ring_file *rf,
+                                    fmode_t mode, void __user *arg) {
+    struct scull_ring_eventfd req;
+    struct eventfd_ctx *ctx[2] = { NULL, NULL };
+    struct eventfd_ctx *got;
+    int i;
+
+    if (copy_from_user(&req, arg, sizeof(req))) {
+        return -EFAULT;
+    }
+    if (!req.events || (req.events & ~(SCULL_RING_EVENTFD_READ | SCULL_RING_EVENTFD_WRITE))) {
+        return -EINVAL;
+    }
+    if (req.events & SCULL_RING_EVENTFD_READ) {
+        if (!(mode & FMODE_READ)) {
+            return -EBADF;
+        }
+        // В режиме BROADCAST звонок следит за позицией подписчика
+        if (req.fd >= 0 && scull_ring_subscribe(buf, rf)) {
+            return -ERESTARTSYS;
+        }
+    }
+
+    // ctx[0] - звонок данных, ctx[1] - звонок места
+    for (i = 0; i < 2; i++) {
+        if (req.fd < 0 || !(req.events & (1u << i))) {
+            continue;
+        }
+        // В ctx[] попадают только полученные контексты: ошибка не должна
+        // дойти до eventfd_ctx_put
+        got = eventfd_ctx_fdget(req.fd);
+        if (IS_ERR(got)) {
+            if (ctx[0]) {
+                eventfd_ctx_put(ctx[0]);
+            }
+            return PTR_ERR(got);
+        }
+        ctx[i] = got;
+    }
+
+    if (mutex_lock_interruptible(&buf->lock)) {
+        for (i = 0; i < 2; i++) {
+            if (ctx[i]) {
+                eventfd_ctx_put(ctx[i]);
+            }
+        }
+        return -ERESTARTSYS;
+    }
+    for (i = 0; i < 2; i++) {
+        if (req.events & (1u << i)) {
+            scull_ring_doorbell_set(buf, rf, i, ctx[i]);
+        }
+    }
+    mutex_unlock(&buf->lock);
+    return 0;
+}
+
+/**
+ * Замена страниц данных кольца: смена размера или перенос на другой узел
+ * @buf: указатель на буфер
+ * @size: новый размер в байтах (степень двойки)
+ * @node: узел NUMA для новых страниц (NUMA_NO_NODE - любой)
+ * Возвращает 0 или код ошибки
+ *
+ * Новые страницы выделяются до захвата кольца, чтобы не держать читателей
+ * и писателей во время выделения мегабайтов памяти. Страницы меняются только
+ * у пустого кольца без отображений; управляющая страница сохраняется, так
+ * что спящие процессы продолжают работать со своими счетчиками.
+ */
+static int scull_ring_buffer_realloc(struct scull_ring_buffer *buf, unsigned int size, int node) {
+    struct page **pages, **old_pages;
+    unsigned int nr_pages, old_nr_pages;
+    char *data, *old_data;
+    int err;
+
+    if (!scull_ring_size_valid(size)) {
+        return -EINVAL;
+    }
+    // Подкольца процессоров выделены при загрузке и живут до выгрузки модуля
+    if (buf->flags & SCULL_RING_F_PERCPU) {
+        return -EBUSY;
+    }
+
+    pages = scull_ring_alloc_data(buf->ctrl_page, size, node, &nr_pages, &data);
+    if (!pages) {
+        return -ENOMEM;
+    }
+
+    err = scull_ring_lock_all(buf);
+    if (err) {
+        scull_ring_free_data(pages, nr_pages, data);
+        return err;
+    }
+    // map_lock берется внутри buf->lock и никогда наоборот: mmap() приходит
+    // с mmap_lock процесса, а копирование под buf->lock может его захватить
+    mutex_lock(&buf->map_lock);
+    if (scull_ring_data_len(buf) != 0 || atomic_read(&buf->mmap_count)) {
+        mutex_unlock(&buf->map_lock);
+        scull_ring_unlock_all(buf);
+        scull_ring_free_data(pages, nr_pages, data);
+        return -EBUSY;
+    }
+
+    old_pages = buf->pages;
+    old_nr_pages = buf->nr_pages;
+    old_data = buf->data;
+
+    write_seqcount_begin(&buf->geom_seq);
+    buf->pages = pages;
+    buf->nr_pages = nr_pages;
+    buf->data = data;
+    buf->size = size;
+    buf->mask = size - 1;
+    buf->data_node = node;
+    buf->ctrl->size = size;
+    buf->ctrl->read_pos = 0;
+    buf->ctrl->write_pos = 0;
+    write_seqcount_end(&buf->geom_seq);
+    buf->mark_head = 0;
+    buf->mark_tail = 0;
+    scull_ring_reset_cursors(buf);
+    mutex_unlock(&buf->map_lock);
+    scull_ring_unlock_all(buf);
+
+    // Спящие писатели могли ждать места, которого в новом кольце не будет
+    wake_up_interruptible(&buf->read_queue);
+    wake_up_interruptible(&buf->write_queue);
+
+    // Снимок мог начать копировать старые данные до смены размера
+    synchronize_rcu();
+    scull_ring_free_data(old_pages, old_nr_pages, old_data);
+    printk(KERN_INFO "scull_ring: Buffer resized to %u bytes (node %d)\n", size, node);
+    return 0;
+}
+
+static int scull_ring_buffer_resize(struct scull_ring_buffer *buf, unsigned int size) {
+    return scull_ring_buffer_realloc(buf, size, buf->data_node);
+}
+
+/**
+ * Перенос данных кольца на узел первого писателя
+ * Вызывается перед каждой записью; работает один раз. Если в кольце уже
+ * есть данные или оно отображено, данные остаются где были.
+ */
+static void scull_ring_place(struct scull_ring_buffer *buf) {
+    int node;
+
+    if (likely(atomic_read(&buf->placed)) || atomic_xchg(&buf->placed, 1)) {
+        return;
+    }
+    node = numa_node_id();
+    if (node != buf->data_node && !(buf->flags & SCULL_RING_F_PERCPU)) {
+        scull_ring_buffer_realloc(buf, buf->size, node);
+    }
+}
+
+/**
+ * Копирование из кольца в итератор (readv, io_uring, splice)
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_copy_to_iter(struct scull_ring_buffer *buf, unsigned int pos, unsigned int len, struct iov_iter *to) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min(len, buf->size - offset);
+
+    if (copy_to_iter(buf->data + offset, first, to) != first) {
+        return -EFAULT;
+    }
+    if (len > first && copy_to_iter(buf->data, len - first, to) != len - first) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * Копирование из итератора в кольцо (writev, io_uring, splice)
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_copy_from_iter(struct scull_ring_buffer *buf, unsigned int pos, unsigned int len, struct iov_iter *from) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min(len, buf->size - offset);
+
+    if (copy_from_iter(buf->data + offset, first, from) != first) {
+        return -EFAULT;
+    }
+    if (len > first && copy_from_iter(buf->data, len - first, from) != len - first) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * Снимок кольца для мониторинга без захвата мьютекса
+ * @buf: указатель на буфер
+ * @snap: выход - позиции, размер и режим кольца
+ * @data: куда скопировать начало данных (NULL - только позиции)
+ * @max_copy: размер data
+ *
+ * Снимок не берет buf->lock и не входит ни в одну сторону, поэтому
+ * монитор не задерживает читателей и писателей. Указатель на данные,
+ * размер и режим меняются только внутри geom_seq, а старые страницы
+ * освобождаются после synchronize_rcu(), так что копировать под
+ * rcu_read_lock() безопасно. Байт на позиции p писатель может затереть
+ * только после того, как read_pos ушла дальше p: после копирования
+ * read_pos перечитывается, и устаревшее начало копии отбрасывается.
+ */
+static void scull_ring_snapshot(struct scull_ring_buffer *buf, struct scull_ring_snap *snap,
+                                char *data, unsigned int max_copy) {
+    unsigned int read_pos, write_pos;
+    unsigned int offset, first, skip;
+    unsigned int seq;
+    char *ring;
+
+    rcu_read_lock();
+    do {
+        seq = read_seqcount_begin(&buf->geom_seq);
+        ring = READ_ONCE(buf->data);
+        snap->size = READ_ONCE(buf->size);
+        snap->flags = READ_ONCE(buf->flags);
+
+        // read_pos читается первой, чтобы write_pos не оказалась позади нее
+        read_pos = smp_load_acquire(&buf->ctrl->read_pos);
+        write_pos = smp_load_acquire(&buf->ctrl->write_pos);
+        if (write_pos - read_pos > snap->size) {
+            // Между чтениями стороны прошли круг, или позиции испорчены через mmap()
+            read_pos = write_pos - snap->size;
+        }
+
+        snap->len = data ? min(write_pos - read_pos, max_copy) : 0;
+        if (snap->len) {
+            offset = read_pos & (snap->size - 1);
+            first = min(snap->len, snap->size - offset);
+            memcpy(data, ring + offset, first);
+            memcpy(data + first, ring, snap->len - first);
+
+            // Все, что читатель успел освободить, писатель мог уже затереть
+            smp_rmb();
+            skip = min(READ_ONCE(buf->ctrl->read_pos) - read_pos, write_pos - read_pos);
+            if (skip >= snap->len) {
+                snap->len = 0;
+            } else if (skip) {
+                memmove(data, data + skip, snap->len - skip);
+                snap->len -= skip;
+            }
+            read_pos += skip;
+        }
+        snap->read_pos = read_pos;
+        snap->data_len = write_pos - read_pos;
+    } while (read_seqcount_retry(&buf->geom_seq, seq));
+    rcu_read_unlock();
+
+    if (snap->flags & SCULL_RING_F_PERCPU) {
+        snap->data_len = scull_ring_subs_len(buf);
+    }
+}
+
+/**
+ * Передача пробуждения следующему потребителю (режим SCULL_RING_F_WORKQUEUE)
+ *
+ * Писатель будит одного исключительно ждущего читателя на каждую запись,
+ * а writev() или запись через mmap() могут положить сразу несколько
+ * сообщений. Читатель, забравший свое, будит следующего, пока в кольце
+ * что-то есть, так что работа расходится по свободным потребителям.
+ */
+static void scull_ring_pass_wakeup(struct scull_ring_buffer *buf) {
+    if (!(buf->flags & SCULL_RING_F_WORKQUEUE)) {
+        return;
+    }
+    if (wq_has_sleeper(&buf->read_queue) && scull_ring_readable(buf, NULL)) {
+        wake_up_interruptible_poll(&buf->read_queue, EPOLLIN | EPOLLRDNORM);
+    }
+}
+
+/**
+ * Продолжение scull_ring_read_end после освобождения стороны
+ * Гистограмма заполненности, трассировка и пробуждение писателей один
+ * раз на всю пачку сообщений.
+ */
+static void scull_ring_read_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked) {
+    unsigned int data_len = scull_ring_data_len(buf);
+
+    scull_ring_hist_add(buf, SCULL_RING_HIST_FILL, data_len);
+    trace_scull_ring_read(buf->minor, bytes, messages, data_len, locked);
+    
+    // Пробуждение ожидающих писателей, если освободилось не меньше порога.
+    // wq_has_sleeper содержит барьер, парный к проверке условия в wait_event
+    if (wq_has_sleeper(&buf->write_queue) && scull_ring_writable(buf, 0)) {
+        wake_up_interruptible_poll(&buf->write_queue, EPOLLOUT | EPOLLWRNORM);
+    }
+    scull_ring_pass_wakeup(buf);
+}
+
+/**
+ * Продолжение scull_ring_write_end после освобождения стороны
+ */
+static void scull_ring_write_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked) {
+    unsigned int data_len = scull_ring_data_len(buf);
+
+    scull_ring_hist_add(buf, SCULL_RING_HIST_FILL, data_len);
+    trace_scull_ring_write(buf->minor, bytes, messages, data_len, locked);
+    
+    // Пробуждение ожидающих читателей, если набралась пачка до порога.
+    // wq_has_sleeper содержит барьер, парный к проверке условия в wait_event
+    if (wq_has_sleeper(&buf->read_queue) && scull_ring_readable(buf, NULL)) {
+        wake_up_interruptible_poll(&buf->read_queue, EPOLLIN | EPOLLRDNORM);
+    }
+}
+
+/**
+ * Освобождение места затиранием старейших сообщений (SCULL_RING_F_OVERWRITE)
+ * @buf: указатель на буфер
+ * @write_pos: текущая позиция записи (данные до нее уже в кольце)
+ * @need: сколько места нужно (не больше размера кольца)
+ * Возвращает свободное место после затирания
+ *
+ * Вызывается писателем под buf->lock: в этом режиме читатели тоже
+ * работают только под мьютексом, поэтому никто не копирует затираемые
+ * данные. Сообщения удаляются целиком; хвост потока байт без '\0'
+ * удаляется весь.
+ */
+static unsigned int scull_ring_overwrite(struct scull_ring_buffer *buf, unsigned int write_pos, unsigned int need) {
+    unsigned int read_pos = buf->ctrl->read_pos;
+    unsigned int payload_pos, payload_len;
+    unsigned int records = 0;
+    unsigned int bytes = 0;
+    int message_len;
+
+    while (buf->size - (write_pos - read_pos) < need && read_pos != write_pos) {
+        message_len = scull_ring_next_message(buf, read_pos, write_pos - read_pos, &payload_pos, &payload_len);
+        if (message_len < 0) {
+            message_len = write_pos - read_pos;
+        }
+        read_pos += message_len;
+        bytes += message_len;
+        records++;
+    }
+
+    if (records) {
+        smp_store_release(&buf->ctrl->read_pos, read_pos);
+        atomic_long_add(records, &buf->dropped);
+        trace_scull_ring_drop(buf->minor, records, bytes);
+    }
+    return buf->size - (write_pos - read_pos);
+}
+
+/**
+ * Пакетное чтение сообщений в итератор (readv, io_uring)
+ * @buf: указатель на буфер
+ * @rf: файл читателя
+ * @to: итератор пользовательских буферов
+ * @nonblock: не спать на пустом кольце
+ * Возвращает количество скопированных байт или код ошибки
+ *
+ * За один захват стороны и одно пробуждение писателей забирает столько
+ * целых сообщений, сколько помещается в итератор. Сообщения копируются
+ * в том виде, в каком лежат в кольце: в режиме потока байт - строки с
+ * '\0', в режиме записей - struct scull_ring_rec_hdr и данные, так что
+ * процесс сам находит границы. Первое сообщение потока байт, которое не
+ * помещается, усекается как в read(); запись, которая не помещается
+ * даже одна, дает -EMSGSIZE.
+ */
+static ssize_t scull_ring_buffer_read_iter(struct scull_ring_buffer *buf, struct scull_ring_file *rf,
+                                          struct iov_iter *to, bool nonblock) {
+    unsigned int read_pos, pos;
+    unsigned int payload_pos, payload_len;
+    size_t room = iov_iter_count(to);
+    int data_len;
+    int message_len;
+    int messages = 0;
+    int total = 0;
+    bool record;
+    bool locked;
+
+    if (room == 0) {
+        return 0;
+    }
+
+    data_len = scull_ring_read_begin(buf, rf, nonblock, &locked, &read_pos);
+    if (data_len < 0) {
+        return data_len;
+    }
+    record = buf->flags & SCULL_RING_F_RECORD;
+
+    pos = read_pos;
+    while (total < data_len) {
+        message_len = scull_ring_next_message(buf, pos, data_len - total, &payload_pos, &payload_len);
+        if (message_len < 0) {
+            if (record && total == 0) {
+                // Неполная запись в голове кольца - порча через mmap()
+                scull_ring_side_exit(buf, &buf->rd, locked);
+                return -EIO;
+            }
+            if (total) {
+                break;
+            }
+            // Поток байт без нуль-терминатора - отдаем что есть, как read()
+            message_len = data_len;
+        }
+        if (message_len > room) {
+            if (total) {
+                break;
+            }
+            if (record) {
+                scull_ring_side_exit(buf, &buf->rd, locked);
+                return -EMSGSIZE;
+            }
+            message_len = room;
+        }
+        if (scull_ring_copy_to_iter(buf, pos, message_len, to)) {
+            if (total) {
+                break;
+            }
+            scull_ring_side_exit(buf, &buf->rd, locked);
+            return -EFAULT;
+        }
+        pos += message_len;
+        total += message_len;
+        room -= message_len;
+        messages++;
+    }
+
+    scull_ring_read_end(buf, rf, pos, messages, total, locked);
+    return total;
+}
+
+/**
+ * Пакетная запись сообщений из итератора (writev, io_uring)
+ * @buf: указатель на буфер
+ * @from: итератор пользовательских буферов
+ * @nonblock: не спать на полном кольце
+ * Возвращает количество записанных байт или код ошибки
+ *
+ * Каждый сегмент итератора (iovec) - отдельное сообщение. За один захват
+ * стороны записываются все сегменты, которые помещаются целиком; если
+ * места нет даже для первого, писатель ждет, как в write().
+ */
+static ssize_t scull_ring_buffer_write_iter(struct scull_ring_buffer *buf, struct iov_iter *from, bool nonblock) {
+    unsigned int write_pos;
+    unsigned int hdr_len;
+    unsigned int used = 0;
+    size_t seg;
+    int available;
+    int messages = 0;
+    int total = 0;
+    bool locked;
+
+    // Пустые сегменты не несут сообщений
+    while (iov_iter_count(from) && iov_iter_single_seg_count(from) == 0) {
+        iov_iter_advance(from, 0);
+    }
+    if (iov_iter_count(from) == 0) {
+        return 0;
+    }
+
+    available = scull_ring_write_begin(buf, iov_iter_single_seg_count(from), nonblock,
+                                       &locked, &write_pos, &hdr_len);
+    if (available < 0) {
+        return available;
+    }
+
+    while (iov_iter_count(from)) {
+        seg = iov_iter_single_seg_count(from);
+        if (seg == 0) {
+            iov_iter_advance(from, 0);
+            continue;
+        }
+        if (hdr_len + seg > available - used && (buf->flags & SCULL_RING_F_OVERWRITE)) {
+            // Место под следующее сообщение - за счет старейших
+            available = used + scull_ring_overwrite(buf, write_pos + used,
+                                                    min_t(size_t, hdr_len + seg, buf->size));
+        }
+        if (hdr_len + seg > available - used) {
+            if (messages || hdr_len) {
+                // Следующее сообщение целиком не помещается - оставим его
+                // до следующего вызова. Первую запись write_begin уже проверил
+                break;
+            }
+            // Первое сообщение потока байт усекается, как в write()
+            seg = available;
+        }
+        if (scull_ring_copy_from_iter(buf, write_pos + used + hdr_len, seg, from)) {
+            if (messages) {
+                break;
+            }
+            scull_ring_side_exit(buf, &buf->wr, locked);
+            return -EFAULT;
+        }
+        if (hdr_len) {
+            scull_ring_put_header(buf, write_pos + used, seg);
+        }
+        used += hdr_len + seg;
+        total += seg;
+        messages++;
+    }
+
+    scull_ring_write_end(buf, write_pos + used, messages, total, locked);
+    return total;
+}
+
+/**
+ * Запись потока в формате кольца из страниц канала (splice)
+ * @buf: указатель на буфер
+ * @from: итератор страниц (ITER_BVEC из scull_ring_splice_write)
+ * @nonblock: не спать на полном кольце
+ * Возвращает количество принятых байт потока или код ошибки
+ *
+ * Страницы канала режут поток на куски произвольной длины, поэтому
+ * сегменты здесь не являются сообщениями. Поток уже размечен так же, как
+ * его отдает read_iter: в режиме потока байт - строки с '\0', они
+ * копируются как есть, сколько поместится; в режиме записей - struct
+ * scull_ring_rec_hdr и данные, принимаются только целые записи. Если
+ * первая запись в потоке неполная или ее длина не помещается в кольцо,
+ * возвращается -EINVAL.
+ */
+static ssize_t scull_ring_buffer_write_stream(struct scull_ring_buffer *buf, struct iov_iter *from, bool nonblock) {
+    struct scull_ring_rec_hdr hdr;
+    unsigned int write_pos;
+    unsigned int hdr_len;
+    unsigned int used = 0;
+    unsigned int pos;
+    size_t first;
+    int available;
+    int message_len;
+    int messages = 0;
+    bool locked;
+
+    if (iov_iter_count(from) == 0) {
+        return 0;
+    }
+
+    // В режиме записей писатель ждет места под первую запись потока
+    first = iov_iter_count(from);
+    if (READ_ONCE(buf->flags) & SCULL_RING_F_RECORD) {
+        if (copy_from_iter(&hdr, sizeof(hdr), from) != sizeof(hdr)) {
+            return -EINVAL;
+        }
+        iov_iter_revert(from, sizeof(hdr));
+        first = hdr.len;
+    }
+
+    available = scull_ring_write_begin(buf, first, nonblock, &locked, &write_pos, &hdr_len);
+    if (available < 0) {
+        return available;
+    }
+
+    if (hdr_len == 0) {
+        // Поток байт: границы сообщений уже лежат в данных
+        used = min_t(size_t, iov_iter_count(from), available);
+        if (scull_ring_copy_from_iter(buf, write_pos, used, from)) {
+            scull_ring_side_exit(buf, &buf->wr, locked);
+            return -EFAULT;
+        }
+        // Счетчик операций учитывает сообщения, завершенные в этом куске
+        for (pos = write_pos; pos != write_pos + used; pos += message_len) {
+            message_len = find_null_terminator(buf, pos, write_pos + used - pos);
+            if (message_len < 0) {
+                break;
+            }
+            messages++;
+        }
+        scull_ring_write_end(buf, write_pos + used, messages, used, locked);
+        return used;
+    }
+
+    // Режим записей: заголовки из потока проверяются и переписываются
+    while (iov_iter_count(from) >= sizeof(hdr)) {
+        if (copy_from_iter(&hdr, sizeof(hdr), from) != sizeof(hdr)) {
+            break;
+        }
+        if (hdr.len <= buf->size - hdr_len && hdr_len + hdr.len > available - used &&
+            (buf->flags & SCULL_RING_F_OVERWRITE)) {
+            available = used + scull_ring_overwrite(buf, write_pos + used, hdr_len + hdr.len);
+        }
+        if (hdr.len > buf->size - hdr_len || hdr.len > iov_iter_count(from) ||
+            hdr_len + hdr.len > available - used) {
+            // Неполная запись или нет места - оставим ее следующему вызову
+            iov_iter_revert(from, sizeof(hdr));
+            break;
+        }
+        if (scull_ring_copy_from_iter(buf, write_pos + used + hdr_len, hdr.len, from)) {
+            break;
+        }
+        // Номер выдает это устройство, метка времени источника сохраняется
+        hdr.seq = (buf->flags & SCULL_RING_F_TIMESTAMP) ? atomic_inc_return(&buf->seq) : 0;
+        if (hdr.tstamp_ns == 0 && (buf->flags & SCULL_RING_F_TIMESTAMP)) {
+            hdr.tstamp_ns = ktime_get_ns();
+        }
+        scull_ring_poke(buf, write_pos + used, &hdr, sizeof(hdr));
+        used += hdr_len + hdr.len;
+        messages++;
+    }
+
+    if (messages == 0) {
+        // Первая запись обрезана длиной splice(), испорчена или режим
+        // кольца сменился, пока процесс ждал места
+        scull_ring_side_exit(buf, &buf->wr, locked);
+        return -EINVAL;
+    }
+
+    scull_ring_write_end(buf, write_pos + used, messages, used, locked);
+    return used;
+}
+
+/**
+ * Копирование из подкольца процессу с учетом перехода через границу
+ * @to: итератор процесса или NULL - тогда копируется в ubuf
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_sub_copy_out(struct scull_ring_buffer *buf, struct scull_ring_sub *sub, unsigned int pos,
+                                   unsigned int len, char __user *ubuf, struct iov_iter *to) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min(len, buf->size - offset);
+
+    if (to) {
+        if (copy_to_iter(sub->data + offset, first, to) != first ||
+            copy_to_iter(sub->data, len - first, to) != len - first) {
+            return -EFAULT;
+        }
+        return 0;
+    }
+    if (copy_to_user(ubuf, sub->data + offset, first) ||
+        copy_to_user(ubuf + first, sub->data, len - first)) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * Копирование от процесса в подкольцо с учетом перехода через границу
+ * @from: итератор процесса или NULL - тогда копируется из ubuf
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_sub_copy_in(struct scull_ring_buffer *buf, struct scull_ring_sub *sub, unsigned int pos,
+                                  unsigned int len, const char __user *ubuf, struct iov_iter *from) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min(len, buf->size - offset);
+
+    if (from) {
+        if (copy_from_iter(sub->data + offset, first, from) != first ||
+            copy_from_iter(sub->data, len - first, from) != len - first) {
+            return -EFAULT;
+        }
+        return 0;
+    }
+    if (copy_from_user(sub->data + offset, ubuf, first) ||
+        copy_from_user(sub->data, ubuf + first, len - first)) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * Чтение и запись заголовка сообщения в подкольце
+ * Заголовок может переходить через границу подкольца.
+ */
+static void scull_ring_sub_get_hdr(struct scull_ring_buffer *buf, struct scull_ring_sub *sub, unsigned int pos,
+                                   struct scull_ring_rec_hdr *hdr) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min_t(unsigned int, sizeof(*hdr), buf->size - offset);
+
+    memcpy(hdr, sub->data + offset, first);
+    memcpy((char *)hdr + first, sub->data, sizeof(*hdr) - first);
+}
+
+static void scull_ring_sub_put_hdr(struct scull_ring_buffer *buf, struct scull_ring_sub *sub, unsigned int pos,
+                                   const struct scull_ring_rec_hdr *hdr) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int first = min_t(unsigned int, sizeof(*hdr), buf->size - offset);
+
+    memcpy(sub->data + offset, hdr, first);
+    memcpy(sub->data, (const char *)hdr + first, sizeof(*hdr) - first);
+}
+
+/**
+ * Запись одного сообщения в подкольцо текущего процессора
+ * @buf: указатель на буфер
+ * @ubuf: данные процесса (если from == NULL)
+ * @from: итератор с данными или NULL
+ * @count: длина сообщения
+ * @nonblock: не спать на полном подкольце
+ * Возвращает количество записанных байт или код ошибки
+ *
+ * Процесс пишет в подкольцо процессора, на котором выполняется. Если
+ * планировщик перенесет его посреди записи, корректность сохраняет
+ * мьютекс подкольца; конкуренция за него остается редкой. Сообщение
+ * длиннее подкольца в режиме записей дает -EMSGSIZE, в потоке байт
+ * усекается.
+ */
+static ssize_t scull_ring_sub_write(struct scull_ring_buffer *buf, const char __user *ubuf,
+                                    struct iov_iter *from, size_t count, bool nonblock) {
+    struct scull_ring_rec_hdr hdr;
+    struct scull_ring_sub *sub;
+    unsigned int write_pos;
+    unsigned int need;
+    int ret;
+
+    if (count > buf->size - sizeof(hdr)) {
+        if (buf->flags & SCULL_RING_F_RECORD) {
+            return -EMSGSIZE;
+        }
+        count = buf->size - sizeof(hdr);
+    }
+    need = sizeof(hdr) + count;
+
+    for (;;) {
+        sub = raw_cpu_ptr(buf->subs);
+        if (mutex_lock_interruptible(&sub->lock)) {
+            return -ERESTARTSYS;
+        }
+        write_pos = sub->write_pos;
+        if (buf->size - (write_pos - smp_load_acquire(&sub->read_pos)) >= need) {
+            break;
+        }
+        mutex_unlock(&sub->lock);
+        if (nonblock) {
+            return -EAGAIN;
+        }
+
+        // БЛОКИРОВКА 2: подкольцо этого процессора полное
+        trace_scull_ring_block(buf->minor, true, scull_ring_sub_len(sub));
+        ret = scull_ring_wait_writable(buf, need);
+        trace_scull_ring_unblock(buf->minor, true, scull_ring_sub_len(sub), ret);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (scull_ring_sub_copy_in(buf, sub, write_pos + sizeof(hdr), count, ubuf, from)) {
+        mutex_unlock(&sub->lock);
+        return -EFAULT;
+    }
+    hdr.len = count;
+    hdr.seq = (buf->flags & SCULL_RING_F_MERGE) ? atomic_inc_return(&buf->seq) : 0;
+    hdr.tstamp_ns = (buf->flags & SCULL_RING_F_TIMESTAMP) ? ktime_get_ns() : 0;
+    scull_ring_sub_put_hdr(buf, sub, write_pos, &hdr);
+    sub->messages++;
+    sub->bytes += count;
+
+    // Публикация сообщения читателю
+    smp_store_release(&sub->write_pos, write_pos + need);
+    mutex_unlock(&sub->lock);
+
+    trace_scull_ring_write(buf->minor, count, 1, scull_ring_sub_len(sub), false);
+    if (wq_has_sleeper(&buf->read_queue) && scull_ring_readable(buf, NULL)) {
+        wake_up_interruptible_poll(&buf->read_queue, EPOLLIN | EPOLLRDNORM);
+    }
+    return count;
+}
+
+/**
+ * Пакетная запись в подкольцо: каждый сегмент итератора - одно сообщение
+ * @buf: указатель на буфер
+ * @from: итератор с сегментами
+ * @nonblock: не спать на полном подкольце
+ * Возвращает количество записанных байт или код ошибки
+ *
+ * Спит только ради первого сообщения; если следующее не помещается,
+ * возвращается уже записанное. Усеченный сегмент пропускается целиком.
+ */
+static ssize_t scull_ring_sub_write_iter(struct scull_ring_buffer *buf, struct iov_iter *from, bool nonblock) {
+    ssize_t total = 0;
+    ssize_t ret;
+    size_t seg;
+
+    while (iov_iter_count(from)) {
+        seg = iov_iter_single_seg_count(from);
+        if (seg == 0) {
+            iov_iter_advance(from, 0);
+            continue;
+        }
+        ret = scull_ring_sub_write(buf, NULL, from, seg, nonblock || total);
+        if (ret < 0) {
+            return total ? total : ret;
+        }
+        iov_iter_advance(from, seg - ret);
+        total += ret;
+    }
+    return total;
+}
+
+/**
+ * Выбор подкольца со следующим сообщением (под buf->lock)
+ * @hdr: выход - заголовок этого сообщения
+ * Возвращает подкольцо или NULL, если все подкольца пусты
+ *
+ * Без SCULL_RING_F_MERGE подкольца обходятся по кругу, чтобы ни один
+ * процессор не голодал. Со слиянием выбирается сообщение с наименьшей
+ * меткой времени (SCULL_RING_F_TIMESTAMP) или порядковым номером среди
+ * уже опубликованных; сообщение, которое еще копируется на другом
+ * процессоре, может оказаться позже более нового.
+ */
+static struct scull_ring_sub *scull_ring_sub_pick(struct scull_ring_buffer *buf, struct scull_ring_rec_hdr *hdr) {
+    struct scull_ring_sub *sub, *best = NULL;
+    struct scull_ring_rec_hdr cur;
+    bool by_time = buf->flags & SCULL_RING_F_TIMESTAMP;
+    unsigned int i;
+    int cpu;
+
+    if (!(buf->flags & SCULL_RING_F_MERGE)) {
+        for (i = 0; i < nr_cpu_ids; i++) {
+            cpu = (buf->sub_next + i) % nr_cpu_ids;
+            if (!cpu_possible(cpu)) {
+                continue;
+            }
+            sub = per_cpu_ptr(buf->subs, cpu);
+            if (smp_load_acquire(&sub->write_pos) != sub->read_pos) {
+                buf->sub_next = cpu + 1;
+                scull_ring_sub_get_hdr(buf, sub, sub->read_pos, hdr);
+                return sub;
+            }
+        }
+        return NULL;
+    }
+
+    for_each_possible_cpu(cpu) {
+        sub = per_cpu_ptr(buf->subs, cpu);
+        if (smp_load_acquire(&sub->write_pos) == sub->read_pos) {
+            continue;
+        }
+        scull_ring_sub_get_hdr(buf, sub, sub->read_pos, &cur);
+        if (!best || (by_time ? cur.tstamp_ns < hdr->tstamp_ns : (int)(cur.seq - hdr->seq) < 0)) {
+            best = sub;
+            *hdr = cur;
+        }
+    }
+    return best;
+}
+
+/**
+ * Чтение из подколец процессоров (режим SCULL_RING_F_PERCPU)
+ * @buf: указатель на буфер
+ * @ubuf: буфер процесса для read() (если to == NULL)
+ * @to: итератор для readv/splice или NULL
+ * @count: размер буфера процесса
+ * @nonblock: не спать, если все подкольца пусты
+ * Возвращает количество скопированных байт или код ошибки
+ *
+ * read() отдает одно сообщение, не поместившийся остаток отбрасывается;
+ * с SCULL_RING_IOCTL_SET_READ_META перед ним идет заголовок.
+ * readv/splice забирают столько целых сообщений, сколько помещается, в
+ * формате кольца: в потоке байт - данные сообщений подряд, в режиме
+ * записей - struct scull_ring_rec_hdr и данные.
+ */
+static ssize_t scull_ring_sub_read(struct scull_ring_buffer *buf, struct scull_ring_file *rf,
+                                   char __user *ubuf, struct iov_iter *to, size_t count, bool nonblock) {
+    struct scull_ring_rec_hdr hdr, out;
+    struct scull_ring_sub *sub;
+    size_t room = count;
+    unsigned int len, out_len;
+    int messages = 0;
+    int total = 0;
+    bool with_hdr, meta;
+    int ret;
+
+    meta = ubuf && rf && READ_ONCE(rf->read_meta);
+    if (meta && count <= sizeof(out)) {
+        return -EINVAL;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    for (;;) {
+        if (mutex_lock_interruptible(&buf->lock)) {
+            return -ERESTARTSYS;
+        }
+        sub = scull_ring_sub_pick(buf, &hdr);
+        if (sub) {
+            break;
+        }
+        mutex_unlock(&buf->lock);
+        if (nonblock) {
+            return -EAGAIN;
+        }
+
+        // БЛОКИРОВКА 1: все подкольца пусты
+        trace_scull_ring_block(buf->minor, false, 0);
+        ret = scull_ring_wait_readable(buf, rf);
+        trace_scull_ring_unblock(buf->minor, false, scull_ring_subs_len(buf), ret);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    with_hdr = (to && (buf->flags & SCULL_RING_F_RECORD)) || meta;
+    ret = 0;
+    while (sub) {
+        len = hdr.len;
+        out_len = with_hdr ? sizeof(out) + len : len;
+        if (out_len > room) {
+            if (messages) {
+                break;
+            }
+            if (with_hdr && !meta) {
+                mutex_unlock(&buf->lock);
+                return -EMSGSIZE;
+            }
+            out_len = room;
+            len = with_hdr ? room - sizeof(out) : room;
+        }
+        if (with_hdr) {
+            out.len = hdr.len;
+            out.seq = hdr.seq;
+            out.tstamp_ns = hdr.tstamp_ns;
+            if (meta ? copy_to_user(ubuf, &out, sizeof(out)) != 0
+                     : copy_to_iter(&out, sizeof(out), to) != sizeof(out)) {
+                ret = -EFAULT;
+            }
+        }
+        if (!ret && scull_ring_sub_copy_out(buf, sub, sub->read_pos + sizeof(hdr), len,
+                                            meta ? ubuf + sizeof(out) : ubuf, to)) {
+            ret = -EFAULT;
+        }
+        if (ret) {
+            // Уже отданные сообщения остаются прочитанными
+            if (messages) {
+                break;
+            }
+            mutex_unlock(&buf->lock);
+            return ret;
+        }
+        // Место в подкольце освобождается целым сообщением
+        smp_store_release(&sub->read_pos, sub->read_pos + sizeof(hdr) + hdr.len);
+        total += out_len;
+        room -= out_len;
+        messages++;
+        if (!to) {
+            break;
+        }
+        sub = scull_ring_sub_pick(buf, &hdr);
+    }
+
+    atomic_add(messages, &buf->read_count);
+    atomic64_add(total, &buf->read_bytes);
+    mutex_unlock(&buf->lock);
+
+    trace_scull_ring_read(buf->minor, total, messages, scull_ring_subs_len(buf), true);
+    if (wq_has_sleeper(&buf->write_queue)) {
+        wake_up_interruptible_poll(&buf->write_queue, EPOLLOUT | EPOLLWRNORM);
+    }
+    scull_ring_pass_wakeup(buf);
+    return total;
+}
+
+/**
+ * Захват устройства открываемым файлом
+ * @minor: младший номер
+ * Возвращает устройство или NULL, если такого нет
+ */
+static struct scull_ring_dev *scull_ring_dev_get(unsigned int minor) {
+    struct scull_ring_dev *dev = NULL;
+
+    mutex_lock(&scull_ring_devices_lock);
+    if (minor < SCULL_RING_MAX_DEVS) {
+        dev = scull_ring_devices[minor];
+    }
+    if (dev) {
+        dev->users++;
+    }
+    mutex_unlock(&scull_ring_devices_lock);
+    return dev;
+}
+
+static void scull_ring_dev_put(struct scull_ring_dev *dev) {
+    mutex_lock(&scull_ring_devices_lock);
+    dev->users--;
+    mutex_unlock(&scull_ring_devices_lock);
+}
+
+/**
+ * Операция открытия устройства
+ */
+static int scull_ring_open(struct inode *inode, struct file *filp) {
+    struct scull_ring_dev *dev;
+    struct scull_ring_file *rf;
+    
+    // Поиск устройства по младшему номеру: его могли удалить через scull_ring_ctl,
+    // пока open() шел к драйверу. Открытый файл не дает удалить устройство
+    dev = scull_ring_dev_get(iminor(inode));
+    if (!dev) {
+        return -ENODEV;
+    }
+
+    rf = kzalloc(sizeof(*rf), GFP_KERNEL);
+    if (!rf) {
+        scull_ring_dev_put(dev);
+        return -ENOMEM;
+    }
+    rf->dev = dev;
+    // Подписчиком кольца файл станет при первом чтении (scull_ring_subscribe)
+    INIT_LIST_HEAD(&rf->node);
+    mutex_init(&rf->splice_lock);
+    filp->private_data = rf;  // Сохранение для использования в других операциях
+    
+    pr_debug("scull_ring: Process %s (pid %d) opened device\n", 
+             current->comm, current->pid);
+    return 0;
+}
+
+/**
+ * Операция закрытия устройства
+ */
+static int scull_ring_release(struct inode *inode, struct file *filp) {
+    struct scull_ring_file *rf = filp->private_data;
+    struct scull_ring_buffer *buf = rf->dev->ring_buf;
+
+    if (rf->read_bell.ctx || rf->write_bell.ctx) {
+        mutex_lock(&buf->lock);
+        scull_ring_doorbell_set(buf, rf, false, NULL);
+        scull_ring_doorbell_set(buf, rf, true, NULL);
+        mutex_unlock(&buf->lock);
+    }
+    scull_ring_unsubscribe(buf, rf);
+    scull_ring_dev_put(rf->dev);
+    kfree(rf);
+
+    pr_debug("scull_ring: Process %s (pid %d) closed device\n", 
+             current->comm, current->pid);
+    return 0;
+}
+
+/**
+ * Файловая операция read - точка входа из пользовательского пространства
+ */
+static ssize_t scull_ring_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos) {
+    struct scull_ring_file *rf = filp->private_data;
+
+    if (scull_ring_subscribe(rf->dev->ring_buf, rf)) {
+        return -ERESTARTSYS;
+    }
+    // Режим PERCPU задается при загрузке и не меняется, проверка без блокировки
+    if (rf->dev->ring_buf->flags & SCULL_RING_F_PERCPU) {
+        return scull_ring_sub_read(rf->dev->ring_buf, rf, buf, NULL, count, filp->f_flags & O_NONBLOCK);
+    }
+    return scull_ring_buffer_read(rf->dev->ring_buf, rf, buf, count, filp->f_flags & O_NONBLOCK);
+}
+
+/**
+ * Файловая операция write - точка входа из пользовательского пространства
+ */
+static ssize_t scull_ring_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos) {
+    struct scull_ring_file *rf = filp->private_data;
+
+    scull_ring_place(rf->dev->ring_buf);
+    if (rf->dev->ring_buf->flags & SCULL_RING_F_PERCPU) {
+        return scull_ring_sub_write(rf->dev->ring_buf, buf, NULL, count, filp->f_flags & O_NONBLOCK);
+    }
+    return scull_ring_buffer_write(rf->dev->ring_buf, buf, count, filp->f_flags & O_NONBLOCK);
+}
+
+/**
+ * Файловая операция read_iter - пакетное чтение (readv, io_uring, splice)
+ */
+static ssize_t scull_ring_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    struct scull_ring_file *rf = iocb->ki_filp->private_data;
+    bool nonblock = (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+
+    if (scull_ring_subscribe(rf->dev->ring_buf, rf)) {
+        return -ERESTARTSYS;
+    }
+    if (rf->dev->ring_buf->flags & SCULL_RING_F_PERCPU) {
+        return scull_ring_sub_read(rf->dev->ring_buf, rf, NULL, to, iov_iter_count(to), nonblock);
+    }
+    return scull_ring_buffer_read_iter(rf->dev->ring_buf, rf, to, nonblock);
+}
+
+/**
+ * Файловая операция write_iter - пакетная запись (writev, io_uring, splice)
+ *
+ * Из splice() (scull_ring_splice_write) приходит поток в формате кольца, а
+ * не отдельные сообщения. В режиме PERCPU такой поток записывается как
+ * одно сообщение.
+ */
+static ssize_t scull_ring_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    struct scull_ring_file *rf = iocb->ki_filp->private_data;
+    bool nonblock = (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+    bool stream = iov_iter_is_bvec(from) && READ_ONCE(rf->splice_task) == current;
+
+    scull_ring_place(rf->dev->ring_buf);
+    if (rf->dev->ring_buf->flags & SCULL_RING_F_PERCPU) {
+        if (stream) {
+            return scull_ring_sub_write(rf->dev->ring_buf, NULL, from, iov_iter_count(from), nonblock);
+        }
+        return scull_ring_sub_write_iter(rf->dev->ring_buf, from, nonblock);
+    }
+    if (stream) {
+        return scull_ring_buffer_write_stream(rf->dev->ring_buf, from, nonblock);
+    }
+    return scull_ring_buffer_write_iter(rf->dev->ring_buf, from, nonblock);
+}
+
+/**
+ * Файловая операция splice_write - запись из канала
+ *
+ * iter_file_splice_write передает страницы канала в write_iter как
+ * ITER_BVEC. Такие же итераторы приходят от io_uring с
+ * зарегистрированными буферами и от писателей внутри ядра, а им нужна
+ * обычная запись сообщениями. Поэтому поток узнается не по типу
+ * итератора, а по отметке rf->splice_task; мьютекс не дает двум splice()
+ * в один файл затереть отметки друг друга.
+ */
+static ssize_t scull_ring_splice_write(struct pipe_inode_info *pipe, struct file *out, loff_t *ppos,
+                                       size_t len, unsigned int flags) {
+    struct scull_ring_file *rf = out->private_data;
+    ssize_t ret;
+
+    if (mutex_lock_interruptible(&rf->splice_lock)) {
+        return -ERESTARTSYS;
+    }
+    WRITE_ONCE(rf->splice_task, current);
+    ret = iter_file_splice_write(pipe, out, ppos, len, flags);
+    WRITE_ONCE(rf->splice_task, NULL);
+    mutex_unlock(&rf->splice_lock);
+    return ret;
+}
+
+/**
+ * Файловая операция poll - готовность кольца для select/poll/epoll
+ * @filp: файловая структура
+ * @wait: таблица ожидания
+ *
+ * Регистрирует процесс на read_queue и write_queue, поэтому один цикл
+ * событий может обслуживать много колец без отдельного потока на каждое.
+ * Чтение готово, если в кольце есть данные; запись готова, если в кольце
+ * помещается хотя бы один байт (в режиме записей - заголовок и байт).
+ */
+static __poll_t scull_ring_poll(struct file *filp, poll_table *wait) {
+    struct scull_ring_file *rf = filp->private_data;
+    struct scull_ring_buffer *buf = rf->dev->ring_buf;
+    unsigned int data_len, hdr_len;
+    __poll_t mask = 0;
+
+    poll_wait(filp, &buf->read_queue, wait);
+    poll_wait(filp, &buf->write_queue, wait);
+
+    data_len = scull_ring_data_len(buf);
+    if (unlikely(data_len > buf->size)) {
+        // Позиции испорчены процессом, отобразившим кольцо через mmap()
+        return EPOLLERR;
+    }
+
+    hdr_len = (buf->flags & SCULL_RING_F_RECORD) ? sizeof(struct scull_ring_rec_hdr) : 0;
+    // В режиме BROADCAST готовность к чтению у каждого подписчика своя
+    if (scull_ring_pending(buf, rf) > 0) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    if (buf->flags & SCULL_RING_F_PERCPU) {
+        // Писатель попадет в подкольцо своего процессора
+        if (scull_ring_writable(buf, sizeof(struct scull_ring_rec_hdr) + 1)) {
+            mask |= EPOLLOUT | EPOLLWRNORM;
+        }
+    } else if (buf->size - data_len > hdr_len || (buf->flags & SCULL_RING_F_OVERWRITE)) {
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    }
+    return mask;
+}
+
+/**
+ * Открытие и закрытие отображения кольца (в том числе при fork и split VMA)
+ */
+static void scull_ring_vm_open(struct vm_area_struct *vma) {
+    struct scull_ring_buffer *buf = vma->vm_private_data;
+    atomic_inc(&buf->mmap_count);
+}
+
+static void scull_ring_vm_close(struct vm_area_struct *vma) {
+    struct scull_ring_buffer *buf = vma->vm_private_data;
+    atomic_dec(&buf->mmap_count);
+}
+
+static const struct vm_operations_struct scull_ring_vm_ops = {
+    .open = scull_ring_vm_open,
+    .close = scull_ring_vm_close,
+};
+
+/**
+ * Файловая операция mmap - отображение управляющей страницы и данных кольца
+ * @filp: файловая структура
+ * @vma: область виртуальной памяти процесса
+ *
+ * Процесс получает прямой доступ к позициям и данным кольца (раскладка
+ * описана в scull_ring_ioctl.h) и обменивается сообщениями без системных
+ * вызовов. В ядро он входит только чтобы уснуть на пустом или полном
+ * кольце (WAIT_READABLE/WAIT_WRITABLE) или разбудить спящих (NOTIFY).
+ */
+static int scull_ring_mmap(struct file *filp, struct vm_area_struct *vma) {
+    struct scull_ring_file *rf = filp->private_data;
+    struct scull_ring_buffer *buf = rf->dev->ring_buf;
+    int err;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+#else
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+    vma->vm_ops = &scull_ring_vm_ops;
+    vma->vm_private_data = buf;
+
+    // vm_map_pages сама проверяет, что vm_pgoff и длина не выходят за страницы кольца
+    mutex_lock(&buf->map_lock);
+    // В режимах OVERWRITE и BROADCAST read_pos сдвигает ядро, и процесс,
+    // читающий кольцо напрямую, не может с ним договориться
+    if (buf->flags & SCULL_RING_LOCKED_MODES) {
+        mutex_unlock(&buf->map_lock);
+        return -EINVAL;
+    }
+    err = vm_map_pages(vma, buf->pages, buf->nr_pages);
+    if (!err) {
+        scull_ring_vm_open(vma);
+    }
+    mutex_unlock(&buf->map_lock);
+    if (err) {
+        return err;
+    }
+
+    pr_debug("scull_ring: Process %s (pid %d) mapped ring (%lu bytes)\n", 
+             current->comm, current->pid, vma->vm_end - vma->vm_start);
+    return 0;
+}
+
+/**
+ * Вывод гистограмм устройства в debugfs (scull_ring/scull_ringN/hist)
+ * Печатаются только непустые корзины: [нижняя граница, верхняя) количество
+ */
+static int scull_ring_hist_show(struct seq_file *m, void *v) {
+    static const char * const names[SCULL_RING_HIST_NR] = {
+        [SCULL_RING_HIST_RESIDENCY] = "residency_ns",
+        [SCULL_RING_HIST_READ_SLEEP] = "read_sleep_ns",
+        [SCULL_RING_HIST_WRITE_SLEEP] = "write_sleep_ns",
+        [SCULL_RING_HIST_FILL] = "fill_bytes",
+    };
+    struct scull_ring_buffer *buf = m->private;
+    struct scull_ring_hist *hist;
+    u64 low;
+    int id, i;
+
+    hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+    if (!hist) {
+        return -ENOMEM;
+    }
+    scull_ring_hist_sum(buf, hist);
+
+    for (id = 0; id < SCULL_RING_HIST_NR; id++) {
+        seq_printf(m, "%s:\n", names[id]);
+        for (i = 0; i < SCULL_RING_HIST_BUCKETS; i++) {
+            if (!hist->buckets[id][i]) {
+                continue;
+            }
+            low = i ? 1ULL << (i - 1) : 0;
+            if (i == SCULL_RING_HIST_BUCKETS - 1) {
+                seq_printf(m, "  [%llu, inf) %llu\n", low, hist->buckets[id][i]);
+            } else {
+                seq_printf(m, "  [%llu, %llu) %llu\n", low, 1ULL << i, hist->buckets[id][i]);
+            }
+        }
+    }
+
+    kfree(hist);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(scull_ring_hist);
+
+/**
+ * Команда SNAPSHOT: двоичный снимок содержимого кольца
+ * @buf: указатель на буфер
+ * @arg: struct scull_ring_snapshot в пользовательском пространстве
+ * Возвращает 0 или код ошибки
+ *
+ * Ядро только копирует байты и размечает границы сообщений; строки
+ * собирает пользовательская программа.
+ */
+static long scull_ring_ioctl_snapshot(struct scull_ring_buffer *buf, void __user *arg) {
+    struct scull_ring_snapshot req;
+    struct scull_ring_rec_desc *desc = NULL;
+    struct scull_ring_snap snap;
+    unsigned int data_size, nr_desc;
+    unsigned int pos = 0, n = 0;
+    char *data = NULL;
+    int message_len;
+    long err = 0;
+
+    if (copy_from_user(&req, arg, sizeof(req))) {
+        return -EFAULT;
+    }
+    if (req.version != SCULL_RING_SNAPSHOT_VERSION) {
+        return -EINVAL;
+    }
+    data_size = min3(req.data_size, READ_ONCE(buf->size), SCULL_RING_SNAPSHOT_MAX_DATA);
+    nr_desc = min_t(__u32, req.nr_desc, SCULL_RING_SNAPSHOT_MAX_DESC);
+    if ((data_size && !req.data) || (nr_desc && !req.desc)) {
+        return -EINVAL;
+    }
+
+    if (data_size) {
+        data = kvmalloc(data_size, GFP_KERNEL);
+        if (!data) {
+            return -ENOMEM;
+        }
+    }
+    if (nr_desc) {
+        desc = kvmalloc_array(nr_desc, sizeof(*desc), GFP_KERNEL);
+        if (!desc) {
+            kvfree(data);
+            return -ENOMEM;
+        }
+    }
+
+    scull_ring_snapshot(buf, &snap, data, data_size);
+    while (n < nr_desc) {
+        message_len = scull_ring_snap_next(&snap, data, pos, &desc[n]);
+        if (message_len < 0) {
+            break;
+        }
+        pos += message_len;
+        n++;
+    }
+
+    req.flags = snap.flags;
+    req.size = snap.size;
+    req.data_len = snap.data_len;
+    req.read_pos = snap.read_pos;
+    req.nr_desc = n;
+    req.data_size = snap.len;
+    req.more = snap.data_len - pos;
+
+    if (copy_to_user(u64_to_user_ptr(req.data), data, snap.len) ||
+        copy_to_user(u64_to_user_ptr(req.desc), desc, n * sizeof(*desc)) ||
+        copy_to_user(arg, &req, sizeof(req))) {
+        err = -EFAULT;
+    }
+    kvfree(desc);
+    kvfree(data);
+    return err;
+}
+
+/**
+ * IOCTL операции для управления и мониторинга устройства
+ * @filp: файловая структура
+ * @cmd: команда IOCTL
+ * @arg: аргумент команды (указатель в пользовательском пространстве)
+ * 
+ * Поддерживаемые команды:
+ * - GET_STATUS: получение статуса буфера (размер, заполненность)
+ * - GET_COUNTERS: получение счетчиков операций чтения/записи
+ * - PEEK_BUFFER: просмотр содержимого буфера без извлечения
+ * - SNAPSHOT: двоичный снимок содержимого (описатели сообщений и сырые байты)
+ * - WAIT_READABLE/WAIT_WRITABLE: сон до появления данных/места (для mmap())
+ * - NOTIFY: пробуждение спящих после сдвига позиций через mmap()
+ * - SET_BUSY_POLL/GET_BUSY_POLL: активное ожидание данных для этого файла
+ * - SET_READ_META: read() этого файла отдает заголовок записи (номер, время)
+ * - SET_EVENTFD: eventfd этого файла вместо сна на очередях кольца
+ * - SET_FLAGS/GET_FLAGS: режим кольца (поток байт или записи с заголовком)
+ * - SET_SIZE: новый размер пустого кольца
+ * - SET_NODE/GET_NODE: узел NUMA для данных кольца
+ */
+static long scull_ring_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+    struct scull_ring_file *rf = filp->private_data;
+    struct scull_ring_buffer *buf = rf->dev->ring_buf;
+    int status[4];
+    long counters[2];
+    char peek_buffer[512];
+    struct scull_ring_snap snap;
+    char *peek_data;
+    struct scull_ring_hist *hist;
+    struct scull_ring_watermark wm;
+    int message_count;
+    __u32 need;
+    __u32 flags;
+    __u32 size;
+    __s32 node;
+    int err, i;
+
+    trace_scull_ring_ioctl(buf->minor, cmd);
+
+    switch (cmd) {
+        case SCULL_RING_IOCTL_GET_STATUS:
+            // Снимок без мьютекса: монитор не задерживает читателей и писателей
+            scull_ring_snapshot(buf, &snap, NULL, 0);
+            status[0] = snap.data_len;  // Текущее количество данных
+            status[1] = snap.size;      // Общий размер буфера
+            status[2] = 0;              // Зарезервировано
+            status[3] = 0;              // Зарезервировано
+
+            // Копирование результатов в пользовательское пространство
+            if (copy_to_user((int __user *)arg, status, sizeof(status))) {
+                return -EFAULT;
             }
             break;
             
         case SCULL_RING_IOCTL_GET_COUNTERS:
             // Получение атомарных счетчиков (не требует мьютекса)
             counters[0] = atomic_read(&buf->read_count);
-            counters[1] = atomic_read(&buf->write_count);
+            counters[1] = atomic_read(&buf->write_count) + scull_ring_sub_messages(buf, NULL);
             
             if (copy_to_user((long __user *)arg, counters, sizeof(counters))) {
                 return -EFAULT;
             }
             break;
             
-        case SCULL_RING_IOCTL_PEEK_BUFFER:
-            // БЛОКИРОВКА 3: IOCTL ждет мьютекс для чтения содержимого буфера
-            if (mutex_lock_interruptible(&buf->lock)) {
-                printk(KERN_INFO "scull_ring: Process %s (pid %d) interrupted while waiting for mutex lock (IOCTL PEEK)\n", 
-                       current->comm, current->pid);
-                return -ERESTARTSYS;
+        case SCULL_RING_IOCTL_PEEK_BUFFER:
+            // Данные копируются без мьютекса, разбор и форматирование идут по копии
+            peek_data = kmalloc(SCULL_RING_PEEK_BYTES, GFP_KERNEL);
+            if (!peek_data) {
+                return -ENOMEM;
+            }
+            scull_ring_snapshot(buf, &snap, peek_data, SCULL_RING_PEEK_BYTES);
+            
+            // Извлечение всех сообщений для отладки
+            message_count = extract_messages(&snap, peek_data, peek_buffer, sizeof(peek_buffer));
+            kfree(peek_data);
+            
+            // Копирование результатов просмотра в пользовательское пространство
+            if (copy_to_user((char __user *)arg, peek_buffer, sizeof(peek_buffer))) {
+                return -EFAULT;
+            }
+            break;
+            
+        case SCULL_RING_IOCTL_SNAPSHOT:
+            return scull_ring_ioctl_snapshot(buf, (void __user *)arg);
+
+        case SCULL_RING_IOCTL_WAIT_READABLE:
+            // Процесс, читающий через mmap(), засыпает на пустом кольце
+            return scull_ring_wait_readable(buf, rf);
+
+        case SCULL_RING_IOCTL_SET_BUSY_POLL:
+            if (get_user(size, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (size > SCULL_RING_BUSY_POLL_MAX_US) {
+                return -EINVAL;
+            }
+            WRITE_ONCE(rf->busy_poll_us, size);
+            break;
+
+        case SCULL_RING_IOCTL_GET_BUSY_POLL:
+            if (put_user(READ_ONCE(rf->busy_poll_us), (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_SET_EVENTFD:
+            return scull_ring_ioctl_eventfd(buf, rf, filp->f_mode, (void __user *)arg);
+
+        case SCULL_RING_IOCTL_SET_READ_META:
+            if (get_user(flags, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            WRITE_ONCE(rf->read_meta, flags != 0);
+            break;
+
+        case SCULL_RING_IOCTL_WAIT_WRITABLE:
+            // Процесс, пишущий через mmap(), ждет нужного количества свободного места
+            if (get_user(need, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (need == 0 || need > buf->size) {
+                return -EINVAL;
+            }
+            return scull_ring_wait_writable(buf, need);
+
+        case SCULL_RING_IOCTL_NOTIFY:
+            // Позиции сдвинуты в пользовательском пространстве - будим обе стороны
+            wake_up_interruptible(&buf->read_queue);
+            wake_up_interruptible(&buf->write_queue);
+            break;
+            
+        case SCULL_RING_IOCTL_SET_FLAGS:
+            if (get_user(flags, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (!scull_ring_flags_valid(flags)) {
+                return -EINVAL;
+            }
+            // PERCPU включается и выключается только параметром модуля
+            if ((flags ^ buf->flags) & SCULL_RING_F_PERCPU) {
+                return -EINVAL;
+            }
+            // Порог read_msgs в BROADCAST не поддерживается (см. SET_WATERMARK)
+            if ((flags & SCULL_RING_F_BROADCAST) && READ_ONCE(buf->wm.read_msgs)) {
+                return -EINVAL;
+            }
+            err = scull_ring_lock_all(buf);
+            if (err) {
+                return err;
+            }
+            // Формат меняется только у пустого кольца, которое никто не отобразил,
+            // иначе уже записанные данные или процесс с mmap() потеряют границы
+            mutex_lock(&buf->map_lock);
+            if (scull_ring_pending(buf, NULL) != 0 || atomic_read(&buf->mmap_count)) {
+                err = -EBUSY;
+            } else {
+                write_seqcount_begin(&buf->geom_seq);
+                buf->flags = flags;
+                buf->ctrl->flags = flags;
+                write_seqcount_end(&buf->geom_seq);
+                scull_ring_reset_cursors(buf);
+            }
+            mutex_unlock(&buf->map_lock);
+            scull_ring_unlock_all(buf);
+            if (err) {
+                return err;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_SET_SIZE:
+            if (get_user(size, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            return scull_ring_buffer_resize(buf, size);
+
+        case SCULL_RING_IOCTL_SET_NODE:
+            if (get_user(node, (__s32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (!scull_ring_node_valid(node)) {
+                return -EINVAL;
+            }
+            if (buf->flags & SCULL_RING_F_PERCPU) {
+                // Подкольца и так лежат на узлах своих процессоров
+                return -EBUSY;
+            }
+            WRITE_ONCE(buf->node, node);
+            if (node == SCULL_RING_NODE_FIRST_WRITER) {
+                // Перенос при следующей записи
+                atomic_set(&buf->placed, 0);
+                break;
+            }
+            atomic_set(&buf->placed, 1);
+            if (node == buf->data_node) {
+                break;
+            }
+            return scull_ring_buffer_realloc(buf, buf->size, node);
+
+        case SCULL_RING_IOCTL_GET_NODE:
+            if (put_user(READ_ONCE(buf->data_node), (__s32 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_SET_WATERMARK:
+            if (copy_from_user(&wm, (void __user *)arg, sizeof(wm))) {
+                return -EFAULT;
+            }
+            if (wm.read_bytes > buf->size || wm.write_bytes > buf->size) {
+                return -EINVAL;
+            }
+            // В BROADCAST сообщение читает каждый подписчик, и общий
+            // read_count не дает отставания отдельного файла
+            if (wm.read_msgs && (READ_ONCE(buf->flags) & SCULL_RING_F_BROADCAST)) {
+                return -EINVAL;
+            }
+            WRITE_ONCE(buf->wm.read_bytes, max(wm.read_bytes, 1u));
+            WRITE_ONCE(buf->wm.read_msgs, wm.read_msgs);
+            WRITE_ONCE(buf->wm.write_bytes, max(wm.write_bytes, 1u));
+            WRITE_ONCE(buf->wm.timeout_ms, wm.timeout_ms);
+            // Спящие проверят условие с новыми порогами; тайм-аут
+            // применяется со следующего засыпания
+            wake_up_interruptible(&buf->read_queue);
+            wake_up_interruptible(&buf->write_queue);
+            break;
+
+        case SCULL_RING_IOCTL_GET_DROPPED:
+            if (put_user((__u64)atomic_long_read(&buf->dropped), (__u64 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_GET_LAPPED:
+            if (put_user((__u64)READ_ONCE(rf->lapped), (__u64 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_GET_WATERMARK:
+            wm.read_bytes = READ_ONCE(buf->wm.read_bytes);
+            wm.read_msgs = READ_ONCE(buf->wm.read_msgs);
+            wm.write_bytes = READ_ONCE(buf->wm.write_bytes);
+            wm.timeout_ms = READ_ONCE(buf->wm.timeout_ms);
+            if (copy_to_user((void __user *)arg, &wm, sizeof(wm))) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_GET_FLAGS:
+            if (put_user(buf->flags, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_GET_HIST:
+            // Гистограммы суммируются по процессорам без захвата кольца
+            hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+            if (!hist) {
+                return -ENOMEM;
+            }
+            scull_ring_hist_sum(buf, hist);
+            err = copy_to_user((void __user *)arg, hist, sizeof(*hist)) ? -EFAULT : 0;
+            kfree(hist);
+            if (err) {
+                return err;
+            }
+            break;
+
+        case SCULL_RING_IOCTL_RESET_HIST:
+            // Обнуление не атомарно с учетом: одновременные события могут потеряться
+            for_each_possible_cpu(i) {
+                memset(per_cpu_ptr(buf->hist, i), 0, sizeof(struct scull_ring_hist));
+            }
+            break;
+            
+        default:
+            // Неизвестная команда IOCTL
+            return -ENOTTY;
+    }
+    return 0;
+}
+
+/**
+ * Сводная статистика одного устройства (без мьютекса кольца)
+ */
+static void scull_ring_dev_stats(struct scull_ring_buffer *buf, struct scull_ring_dev_stats *st) {
+    struct scull_ring_snap snap;
+    u64 sub_bytes;
+
+    scull_ring_snapshot(buf, &snap, NULL, 0);
+    memset(st, 0, sizeof(*st));
+    st->minor = buf->minor;
+    st->flags = snap.flags;
+    st->size = snap.size;
+    st->data_len = snap.data_len;
+    st->read_msgs = (unsigned int)atomic_read(&buf->read_count);
+    st->write_msgs = (unsigned int)atomic_read(&buf->write_count) + scull_ring_sub_messages(buf, &sub_bytes);
+    st->read_bytes = atomic64_read(&buf->read_bytes);
+    st->write_bytes = atomic64_read(&buf->write_bytes) + sub_bytes;
+    st->read_blocked = atomic_long_read(&buf->read_blocked);
+    st->write_blocked = atomic_long_read(&buf->write_blocked);
+    st->dropped = atomic_long_read(&buf->dropped);
+}
+
+/**
+ * Создание кольца и его узла /dev/scull_ringN
+ * @minor: свободный младший номер (меньше SCULL_RING_MAX_DEVS)
+ * @size: размер кольца
+ * @flags: режим кольца SCULL_RING_F_*
+ * @node: узел NUMA для данных (см. scull_ring_nodes)
+ * Возвращает 0 или код ошибки
+ *
+ * Вызывается под scull_ring_devices_lock, поэтому open() увидит
+ * устройство только полностью созданным.
+ */
+static int scull_ring_dev_create(unsigned int minor, unsigned int size, unsigned int flags, int node) {
+    struct scull_ring_dev *scull_dev;
+    dev_t devno = MKDEV(scull_ring_major, minor);
+    char name[32];
+    int err;
+
+    scull_dev = kzalloc(sizeof(*scull_dev), GFP_KERNEL);
+    if (!scull_dev) {
+        return -ENOMEM;
+    }
+
+    // Выделение памяти для структуры буфера (рядом с данными, если узел задан)
+    scull_dev->ring_buf = kmalloc_node(sizeof(struct scull_ring_buffer), GFP_KERNEL,
+                                       node >= 0 ? node : NUMA_NO_NODE);
+    if (!scull_dev->ring_buf) {
+        err = -ENOMEM;
+        goto fail_dev;
+    }
+
+    // Инициализация кольцевого буфера
+    err = scull_ring_buffer_init(scull_dev->ring_buf, minor, size, flags, node);
+    if (err) {
+        goto fail_buf;
+    }
+
+    // Регистрация символьного устройства. cdev выделяется отдельно: после
+    // удаления кольца его еще может держать open(), дошедший до драйвера
+    scull_dev->cdev = cdev_alloc();
+    if (!scull_dev->cdev) {
+        err = -ENOMEM;
+        goto fail_init;
+    }
+    scull_dev->cdev->ops = &scull_ring_fops;
+    scull_dev->cdev->owner = THIS_MODULE;
+    err = cdev_add(scull_dev->cdev, devno, 1);
+    if (err) {
+        printk(KERN_NOTICE "Error %d adding scull_ring%u", err, minor);
+        kobject_put(&scull_dev->cdev->kobj);
+        goto fail_init;
+    }
+
+    // Узел /dev/scull_ringN создает udev/devtmpfs
+    scull_dev->device = device_create(scull_ring_class, NULL, devno, NULL, DEVICE_NAME "%u", minor);
+    if (IS_ERR(scull_dev->device)) {
+        err = PTR_ERR(scull_dev->device);
+        goto fail_cdev;
+    }
+
+    // scull_ring/scull_ringN/hist
+    snprintf(name, sizeof(name), DEVICE_NAME "%u", minor);
+    scull_dev->ring_buf->debugfs = debugfs_create_dir(name, scull_ring_debugfs);
+    debugfs_create_file("hist", 0444, scull_dev->ring_buf->debugfs,
+                        scull_dev->ring_buf, &scull_ring_hist_fops);
+
+    scull_ring_devices[minor] = scull_dev;
+    return 0;
+
+fail_cdev:
+    cdev_del(scull_dev->cdev);
+fail_init:
+    scull_ring_buffer_cleanup(scull_dev->ring_buf);
+fail_buf:
+    kfree(scull_dev->ring_buf);
+fail_dev:
+    kfree(scull_dev);
+    return err;
+}
+
+/**
+ * Удаление кольца и его узла (под scull_ring_devices_lock)
+ * Устройство не должно быть открыто или отображено.
+ */
+static void scull_ring_dev_destroy(struct scull_ring_dev *scull_dev) {
+    unsigned int minor = scull_dev->ring_buf->minor;
+
+    scull_ring_devices[minor] = NULL;
+    // Файлы debugfs ссылаются на буфер - удаляем их первыми
+    debugfs_remove_recursive(scull_dev->ring_buf->debugfs);
+    device_destroy(scull_ring_class, MKDEV(scull_ring_major, minor));
+    cdev_del(scull_dev->cdev);
+    scull_ring_buffer_cleanup(scull_dev->ring_buf);
+    kfree(scull_dev->ring_buf);
+    kfree(scull_dev);
+}
+
+/**
+ * IOCTL управляющего устройства /dev/scull_ring_ctl
+ *
+ * GET_ALL_STATS: статистика всех колец одним вызовом вместо открытия
+ * каждого устройства и нескольких ioctl на каждое.
+ * CREATE/DESTROY: добавление и удаление колец без перезагрузки модуля
+ * (нужен CAP_SYS_ADMIN); удалить можно только не открытое кольцо.
+ */
+static long scull_ring_ctl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+    struct scull_ring_stats req;
+    struct scull_ring_dev_stats *st;
+    struct scull_ring_create create;
+    struct scull_ring_dev *scull_dev;
+    unsigned int n, i, total;
+    __u32 minor;
+    long err = 0;
+
+    switch (cmd) {
+        case SCULL_RING_IOCTL_GET_ALL_STATS:
+            if (copy_from_user(&req, (void __user *)arg, sizeof(req))) {
+                return -EFAULT;
             }
-            
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) acquired mutex for ioctl peek\n", 
-                   current->comm, current->pid);
-            
-            // Извлечение всех сообщений для отладки
-            message_count = extract_messages(buf, peek_buffer, sizeof(peek_buffer));
-            
-            mutex_unlock(&buf->lock);
-            
-            printk(KERN_INFO "scull_ring: Process %s (pid %d) released mutex after ioctl peek\n", 
-                   current->comm, current->pid);
-            
-            // Копирование результатов просмотра в пользовательское пространство
-            if (copy_to_user((char __user *)arg, peek_buffer, sizeof(peek_buffer))) {
+            if (req.version != SCULL_RING_STATS_VERSION) {
+                return -EINVAL;
+            }
+            n = min_t(__u32, req.nr_devs, SCULL_RING_MAX_DEVS);
+            if (n && !req.devs) {
+                return -EINVAL;
+            }
+
+            st = kvmalloc_array(max(n, 1u), sizeof(*st), GFP_KERNEL);
+            if (!st) {
+                return -ENOMEM;
+            }
+            // Таблица держится только ради того, чтобы кольца не удалили;
+            // сами кольца не блокируются
+            mutex_lock(&scull_ring_devices_lock);
+            for (i = 0, total = 0; i < SCULL_RING_MAX_DEVS; i++) {
+                if (!scull_ring_devices[i]) {
+                    continue;
+                }
+                if (total < n) {
+                    scull_ring_dev_stats(scull_ring_devices[i]->ring_buf, &st[total]);
+                }
+                total++;
+            }
+            mutex_unlock(&scull_ring_devices_lock);
+            req.nr_devs = min(n, total);
+            req.total_devs = total;
+            n = req.nr_devs;
+            if (copy_to_user(u64_to_user_ptr(req.devs), st, n * sizeof(*st)) ||
+                copy_to_user((void __user *)arg, &req, sizeof(req))) {
+                err = -EFAULT;
+            }
+            kvfree(st);
+            return err;
+
+        case SCULL_RING_IOCTL_CREATE:
+            if (!capable(CAP_SYS_ADMIN)) {
+                return -EPERM;
+            }
+            if (copy_from_user(&create, (void __user *)arg, sizeof(create))) {
                 return -EFAULT;
             }
-            break;
-            
+            if (create.size == 0) {
+                create.size = SCULL_RING_BUFFER_SIZE;
+            }
+            mutex_lock(&scull_ring_devices_lock);
+            if (create.minor == SCULL_RING_MINOR_ANY) {
+                // Первый свободный номер
+                for (minor = 0; minor < SCULL_RING_MAX_DEVS && scull_ring_devices[minor]; minor++)
+                    ;
+                err = minor < SCULL_RING_MAX_DEVS ? 0 : -ENOSPC;
+            } else {
+                minor = create.minor;
+                if (minor >= SCULL_RING_MAX_DEVS) {
+                    err = -EINVAL;
+                } else if (scull_ring_devices[minor]) {
+                    err = -EEXIST;
+                }
+            }
+            if (!err) {
+                err = scull_ring_dev_create(minor, create.size, create.flags, NUMA_NO_NODE);
+            }
+            mutex_unlock(&scull_ring_devices_lock);
+            if (err) {
+                return err;
+            }
+            if (put_user(minor, &((struct scull_ring_create __user *)arg)->minor)) {
+                return -EFAULT;
+            }
+            printk(KERN_INFO "scull_ring: created scull_ring%u\n", minor);
+            return 0;
+
+        case SCULL_RING_IOCTL_DESTROY:
+            if (!capable(CAP_SYS_ADMIN)) {
+                return -EPERM;
+            }
+            if (get_user(minor, (__u32 __user *)arg)) {
+                return -EFAULT;
+            }
+            if (minor >= SCULL_RING_MAX_DEVS) {
+                return -EINVAL;
+            }
+            mutex_lock(&scull_ring_devices_lock);
+            scull_dev = scull_ring_devices[minor];
+            if (!scull_dev) {
+                err = -ENODEV;
+            } else if (scull_dev->users || atomic_read(&scull_dev->ring_buf->mmap_count)) {
+                // Открытые файлы и отображения ссылаются на буфер
+                err = -EBUSY;
+            } else {
+                scull_ring_dev_destroy(scull_dev);
+            }
+            mutex_unlock(&scull_ring_devices_lock);
+            if (!err) {
+                printk(KERN_INFO "scull_ring: destroyed scull_ring%u\n", minor);
+            }
+            return err;
+
         default:
-            // Неизвестная команда IOCTL
             return -ENOTTY;
     }
+}
+
+static const struct file_operations scull_ring_ctl_fops = {
+    .owner = THIS_MODULE,
+    .unlocked_ioctl = scull_ring_ctl_ioctl,
+};
+
+// Управляющее устройство: узел /dev/scull_ring_ctl создается автоматически
+static struct miscdevice scull_ring_ctl = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = SCULL_RING_CTL_NAME,
+    .fops = &scull_ring_ctl_fops,
+    .mode = 0666,
+};
+
+/**
+ * Права узлов /dev/scull_ringN: кольца доступны всем, как и раньше после
+ * chmod 666 в load_driver.sh
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 2, 0)
+static char *scull_ring_devnode(const struct device *dev, umode_t *mode) {
+#else
+static char *scull_ring_devnode(struct device *dev, umode_t *mode) {
+#endif
+    if (mode) {
+        *mode = 0666;
+    }
+    return NULL;
+}
+
+/**
+ * Удаление всех колец (при выгрузке модуля открытых файлов уже нет)
+ */
+static void scull_ring_destroy_all(void) {
+    int i;
+
+    mutex_lock(&scull_ring_devices_lock);
+    for (i = 0; i < SCULL_RING_MAX_DEVS; i++) {
+        if (scull_ring_devices[i]) {
+            scull_ring_dev_destroy(scull_ring_devices[i]);
+        }
+    }
+    mutex_unlock(&scull_ring_devices_lock);
+}
+
+/*
+ * Микробенчмарк кольца в ядре (debugfs scull_ring/bench).
+ * Потоки ядра пишут в приватное кольцо и читают из него теми же функциями,
+ * что и write_iter/read_iter, но без системных вызовов и copy_to_user:
+ * итераторы указывают на буферы ядра (kvec). Результат - цена самого
+ * кольца в выбранном режиме.
+ */
+#define SCULL_RING_BENCH_MAX_THREADS 32   // Предел производителей и потребителей (каждых)
+#define SCULL_RING_BENCH_MAX_BATCH 32     // Сообщений в одном вызове записи
+#define SCULL_RING_BENCH_MAX_MSG 4096     // Предел размера сообщения
+#define SCULL_RING_BENCH_READ_SIZE (64 * 1024)  // Буфер чтения потребителя
+#define SCULL_RING_BENCH_CMD_SIZE 256     // Предел длины команды запуска
+#define SCULL_RING_BENCH_RESULT_SIZE 1024 // Предел длины отчета
+
+// Параметры запуска (записываются в debugfs как key=value)
+struct scull_ring_bench_cfg {
+    unsigned long records;   // Сообщений от каждого производителя
+    unsigned int size;       // Размер кольца
+    unsigned int flags;      // Режим кольца SCULL_RING_F_*
+    unsigned int msg;        // Размер сообщения
+    unsigned int batch;      // Сообщений в одном вызове записи
+    unsigned int producers;  // Потоков-писателей
+    unsigned int consumers;  // Потоков-читателей
+    cpumask_t cpus;          // Процессоры для потоков по кругу (пусто - без привязки)
+};
+
+struct scull_ring_bench;
+
+// Поток бенчмарка: производитель или потребитель
+struct scull_ring_bench_thread {
+    struct scull_ring_bench *bench;
+    struct task_struct *task;
+    struct scull_ring_file rf;   // Позиция чтения потребителя
+    char *data;                  // Буфер чтения потребителя
+    unsigned long messages;      // Сообщений записано или прочитано
+    u64 end_ns;                  // Когда поток закончил работу
+    int err;                     // Первая ошибка потока
+};
+
+// Один запуск: кольцо, потоки и счетчики завершения
+struct scull_ring_bench {
+    struct scull_ring_bench_cfg cfg;
+    struct scull_ring_buffer *buf;
+    struct scull_ring_bench_thread *threads;  // Сначала производители, затем потребители
+    char *msg;               // Содержимое обычного сообщения
+    char *poison;            // Сообщение "стоп" для потребителей
+    atomic_t producers_left;
+    atomic_t consumers_left;
+    struct completion producers_done;
+    struct completion consumers_done;
+};
+
+static DEFINE_MUTEX(scull_ring_bench_lock);  // Один запуск за раз; защищает отчет
+static char scull_ring_bench_result[SCULL_RING_BENCH_RESULT_SIZE] = "no runs yet\n";
+
+/**
+ * Конец работы потока: ожидание kthread_stop
+ * @left: счетчик потоков своей группы
+ * @done: завершение группы (срабатывает на последнем потоке)
+ *
+ * Поток не выходит сам, чтобы kthread_stop не обращался к уже
+ * освобожденной задаче. Ждет в TASK_IDLE: SIGKILL от прерванного прогона
+ * (scull_ring_bench_abort) не должен превратить ожидание в цикл.
+ */
+static int scull_ring_bench_finish(struct scull_ring_bench_thread *t, atomic_t *left,
+                                   struct completion *done) {
+    if (atomic_dec_and_test(left)) {
+        complete(done);
+    }
+    for (;;) {
+        set_current_state(TASK_IDLE);
+        if (kthread_should_stop()) {
+            break;
+        }
+        schedule();
+    }
+    __set_current_state(TASK_RUNNING);
+    return t->err;
+}
+
+/**
+ * Запись пачки сообщений в кольцо бенчмарка (как write_iter)
+ */
+static ssize_t scull_ring_bench_write(struct scull_ring_buffer *buf, struct iov_iter *from, bool nonblock) {
+    if (buf->flags & SCULL_RING_F_PERCPU) {
+        return scull_ring_sub_write_iter(buf, from, nonblock);
+    }
+    return scull_ring_buffer_write_iter(buf, from, nonblock);
+}
+
+/**
+ * Поток-производитель: records сообщений пачками по batch
+ *
+ * В потоке байт write_begin может взять только часть сообщения;
+ * остаток дописывается следующим вызовом, чтобы каждое сообщение
+ * дошло до читателя целиком и с '\0'.
+ */
+static int scull_ring_bench_producer(void *data) {
+    struct scull_ring_bench_thread *t = data;
+    struct scull_ring_bench *bench = t->bench;
+    struct kvec vec[SCULL_RING_BENCH_MAX_BATCH];
+    struct iov_iter it;
+    unsigned int msg = bench->cfg.msg;
+    unsigned long left = bench->cfg.records;
+    unsigned int off = 0;
+    unsigned int n, i;
+    ssize_t ret;
+
+    // Прерванный прогон снимает поток со сна в кольце через SIGKILL
+    allow_signal(SIGKILL);
+    for (i = 0; i < bench->cfg.batch; i++) {
+        vec[i].iov_base = bench->msg;
+        vec[i].iov_len = msg;
+    }
+    while (left) {
+        n = min_t(unsigned long, left, bench->cfg.batch);
+        vec[0].iov_base = bench->msg + off;
+        vec[0].iov_len = msg - off;
+        iov_iter_kvec(&it, ITER_SOURCE, vec, n, n * msg - off);
+        ret = scull_ring_bench_write(bench->buf, &it, false);
+        if (ret < 0) {
+            t->err = ret;
+            break;
+        }
+        ret += off;
+        left -= ret / msg;
+        t->messages += ret / msg;
+        off = ret % msg;
+    }
+    t->end_ns = ktime_get_ns();
+    return scull_ring_bench_finish(t, &bench->producers_left, &bench->producers_done);
+}
+
+/**
+ * Поток-потребитель: читает, пока не встретит сообщение "стоп"
+ *
+ * Сообщения разбираются по формату кольца: в режиме записей - по
+ * заголовкам (read_iter отдает только целые записи), в потоке байт - по
+ * '\0' (каждое сообщение бенчмарка заканчивается нулем, в том числе в
+ * подкольцах PERCPU). В потоке байт сообщение может разойтись на два
+ * чтения: оно считается и проверяется на "стоп" по первому байту, только
+ * когда дошел его '\0'.
+ */
+static int scull_ring_bench_consumer(void *data) {
+    struct scull_ring_bench_thread *t = data;
+    struct scull_ring_bench *bench = t->bench;
+    struct scull_ring_buffer *buf = bench->buf;
+    bool record = buf->flags & SCULL_RING_F_RECORD;
+    struct scull_ring_rec_hdr hdr;
+    struct kvec vec = { .iov_base = t->data, .iov_len = SCULL_RING_BENCH_READ_SIZE };
+    struct iov_iter it;
+    bool in_msg = false;     // Начало сообщения прочитано, '\0' еще нет
+    bool poison = false;     // Текущее сообщение - "стоп"
+    bool stop = false;
+    char *end;
+    ssize_t ret;
+    size_t pos;
+
+    allow_signal(SIGKILL);
+    while (!stop) {
+        iov_iter_kvec(&it, ITER_DEST, &vec, 1, vec.iov_len);
+        if (buf->flags & SCULL_RING_F_PERCPU) {
+            ret = scull_ring_sub_read(buf, &t->rf, NULL, &it, vec.iov_len, false);
+        } else {
+            ret = scull_ring_buffer_read_iter(buf, &t->rf, &it, false);
+        }
+        if (ret < 0) {
+            t->err = ret;
+            break;
+        }
+        for (pos = 0; pos < ret && !stop; ) {
+            if (record) {
+                memcpy(&hdr, t->data + pos, sizeof(hdr));
+                pos += sizeof(hdr);
+                stop = hdr.len && t->data[pos] == 'P';
+                pos += hdr.len;
+            } else {
+                if (!in_msg) {
+                    poison = t->data[pos] == 'P';
+                    in_msg = true;
+                }
+                end = memchr(t->data + pos, '\0', ret - pos);
+                if (!end) {
+                    break;  // Остаток сообщения придет следующим чтением
+                }
+                pos = end - t->data + 1;
+                in_msg = false;
+                stop = poison;
+            }
+            if (!stop) {
+                t->messages++;
+                t->end_ns = ktime_get_ns();
+            }
+        }
+    }
+
+    // Отписка сразу: в режиме BROADCAST ушедший читатель не держит место
+    scull_ring_unsubscribe(buf, &t->rf);
+    return scull_ring_bench_finish(t, &bench->consumers_left, &bench->consumers_done);
+}
+
+/**
+ * Разбор команды запуска: "records=N size=N flags=N msg=N batch=N
+ * producers=N consumers=N cpus=LIST" (любые ключи можно опустить)
+ * @cfg: параметры, заполненные значениями по умолчанию
+ * @cmd: строка команды (портится)
+ * Возвращает 0 или -EINVAL
+ */
+static int scull_ring_bench_parse(struct scull_ring_bench_cfg *cfg, char *cmd) {
+    char *key, *val;
+    int err;
+
+    while ((key = strsep(&cmd, " \t\n")) != NULL) {
+        if (!*key) {
+            continue;
+        }
+        val = strchr(key, '=');
+        if (!val) {
+            return -EINVAL;
+        }
+        *val++ = '\0';
+        if (!strcmp(key, "records")) {
+            err = kstrtoul(val, 0, &cfg->records);
+        } else if (!strcmp(key, "size")) {
+            err = kstrtouint(val, 0, &cfg->size);
+        } else if (!strcmp(key, "flags")) {
+            err = kstrtouint(val, 0, &cfg->flags);
+        } else if (!strcmp(key, "msg")) {
+            err = kstrtouint(val, 0, &cfg->msg);
+        } else if (!strcmp(key, "batch")) {
+            err = kstrtouint(val, 0, &cfg->batch);
+        } else if (!strcmp(key, "producers")) {
+            err = kstrtouint(val, 0, &cfg->producers);
+        } else if (!strcmp(key, "consumers")) {
+            err = kstrtouint(val, 0, &cfg->consumers);
+        } else if (!strcmp(key, "cpus")) {
+            err = cpulist_parse(val, &cfg->cpus);
+        } else {
+            err = -EINVAL;
+        }
+        if (err) {
+            return -EINVAL;
+        }
+    }
+
+    // Размер и режим кольца проверяет scull_ring_buffer_init. Сообщение
+    // не короче двух байт: первый отличает "стоп", последний - '\0'
+    if (!cfg->records || cfg->msg < 2 || cfg->msg > SCULL_RING_BENCH_MAX_MSG ||
+        cfg->msg + sizeof(struct scull_ring_rec_hdr) > cfg->size ||
+        !cfg->batch || cfg->batch > SCULL_RING_BENCH_MAX_BATCH ||
+        !cfg->producers || cfg->producers > SCULL_RING_BENCH_MAX_THREADS ||
+        !cfg->consumers || cfg->consumers > SCULL_RING_BENCH_MAX_THREADS) {
+        return -EINVAL;
+    }
     return 0;
 }
 
+/**
+ * Прерывание прогона: SIGKILL снимает потоки со сна в кольце
+ * (потоки разрешили его себе через allow_signal), и они доходят до
+ * scull_ring_bench_finish с ошибкой.
+ */
+static void scull_ring_bench_abort(struct scull_ring_bench *bench) {
+    unsigned int i;
+
+    for (i = 0; i < bench->cfg.producers + bench->cfg.consumers; i++) {
+        send_sig(SIGKILL, bench->threads[i].task, 1);
+    }
+}
+
+/**
+ * Ожидание производителей
+ * Возвращает 0, -EINTR, если процесс, запустивший прогон, убит, или
+ * ошибку потребителей, если они все вышли раньше: тогда производитель
+ * на полном кольце не дождался бы места.
+ */
+static int scull_ring_bench_wait_producers(struct scull_ring_bench *bench) {
+    unsigned int i;
+    long left;
+
+    for (;;) {
+        left = wait_for_completion_killable_timeout(&bench->producers_done, HZ / 10);
+        if (left > 0) {
+            return 0;
+        }
+        if (left < 0) {
+            return -EINTR;
+        }
+        if (completion_done(&bench->consumers_done)) {
+            break;
+        }
+    }
+    for (i = bench->cfg.producers; i < bench->cfg.producers + bench->cfg.consumers; i++) {
+        if (bench->threads[i].err) {
+            return bench->threads[i].err;
+        }
+    }
+    return -EPIPE;
+}
+
+/**
+ * Остановка потребителей: ровно одно сообщение "стоп" на каждого
+ * живого потребителя (в режиме BROADCAST одно на всех - его видит каждый)
+ * Возвращает 0, -EINTR или ошибку записи
+ *
+ * Запись без сна: если кольцо полно, дописывается только недостающее
+ * (в потоке байт - и остаток усеченного сообщения), пока потребители
+ * разбирают кольцо. Если все потребители уже вышли, слать некому.
+ */
+static int scull_ring_bench_stop_consumers(struct scull_ring_bench *bench) {
+    unsigned int msg = bench->cfg.msg;
+    unsigned int need, sent = 0, off = 0;
+    struct iov_iter it;
+    struct kvec vec;
+    ssize_t ret;
+    long left;
+
+    need = (bench->buf->flags & SCULL_RING_F_BROADCAST) ? 1 : atomic_read(&bench->consumers_left);
+    while (sent < need) {
+        vec.iov_base = bench->poison + off;
+        vec.iov_len = msg - off;
+        iov_iter_kvec(&it, ITER_SOURCE, &vec, 1, vec.iov_len);
+        ret = scull_ring_bench_write(bench->buf, &it, true);
+        if (ret > 0) {
+            off += ret;
+            if (off == msg) {
+                sent++;
+                off = 0;
+            }
+            continue;
+        }
+        if (ret != -EAGAIN) {
+            return ret;
+        }
+        left = wait_for_completion_killable_timeout(&bench->consumers_done, HZ / 100);
+        if (left < 0) {
+            return -EINTR;
+        }
+        if (left > 0) {
+            return 0;
+        }
+    }
+    return wait_for_completion_killable(&bench->consumers_done) ? -EINTR : 0;
+}
+
+/**
+ * Прогон бенчмарка и отчет в scull_ring_bench_result (под scull_ring_bench_lock)
+ * @bench: запуск с заполненными параметрами
+ * Возвращает 0 или код ошибки
+ *
+ * Время считается от запуска потоков до последнего записанного или
+ * прочитанного обычного сообщения. Пробуждения - засыпания читателей на
+ * пустом и писателей на полном кольце (каждое кончается пробуждением),
+ * конкуренция - уходы стороны на мьютекс из-за второго процесса.
+ */
+static int scull_ring_bench_run(struct scull_ring_bench *bench) {
+    struct scull_ring_bench_cfg *cfg = &bench->cfg;
+    unsigned int nr = cfg->producers + cfg->consumers;
+    struct scull_ring_bench_thread *t;
+    struct scull_ring_buffer *buf;
+    unsigned long written = 0, consumed = 0, wakeups;
+    u64 start, end = 0, elapsed;
+    int cpu = -1;
+    int err = 0;
+    unsigned int i;
+
+    buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+    bench->threads = kcalloc(nr, sizeof(*bench->threads), GFP_KERNEL);
+    bench->msg = kmalloc(cfg->msg, GFP_KERNEL);
+    bench->poison = kmalloc(cfg->msg, GFP_KERNEL);
+    if (!buf || !bench->threads || !bench->msg || !bench->poison) {
+        err = -ENOMEM;
+        goto out_free;
+    }
+    err = scull_ring_buffer_init(buf, -1, cfg->size, cfg->flags, NUMA_NO_NODE);
+    if (err) {
+        goto out_free;
+    }
+    bench->buf = buf;
+
+    memset(bench->msg, 'x', cfg->msg);
+    bench->msg[cfg->msg - 1] = '\0';
+    memset(bench->poison, 'P', cfg->msg);
+    bench->poison[cfg->msg - 1] = '\0';
+    atomic_set(&bench->producers_left, cfg->producers);
+    atomic_set(&bench->consumers_left, cfg->consumers);
+    init_completion(&bench->producers_done);
+    init_completion(&bench->consumers_done);
+
+    // Потоки создаются все сразу и до запуска привязываются к процессорам
+    for (i = 0; i < nr; i++) {
+        t = &bench->threads[i];
+        t->bench = bench;
+        INIT_LIST_HEAD(&t->rf.node);
+        if (i < cfg->producers) {
+            t->task = kthread_create(scull_ring_bench_producer, t, "scull_ring_bp/%u", i);
+        } else {
+            t->data = kvmalloc(SCULL_RING_BENCH_READ_SIZE, GFP_KERNEL);
+            if (!t->data) {
+                err = -ENOMEM;
+                break;
+            }
+            // Потребитель подписывается до старта, чтобы в режиме
+            // BROADCAST увидеть все сообщения
+            err = scull_ring_subscribe(buf, &t->rf);
+            if (err) {
+                break;
+            }
+            t->task = kthread_create(scull_ring_bench_consumer, t, "scull_ring_bc/%u",
+                                     i - cfg->producers);
+        }
+        if (IS_ERR(t->task)) {
+            err = PTR_ERR(t->task);
+            t->task = NULL;
+            break;
+        }
+        if (!cpumask_empty(&cfg->cpus)) {
+            cpu = cpumask_next(cpu, &cfg->cpus);
+            if (cpu >= nr_cpu_ids) {
+                cpu = cpumask_first(&cfg->cpus);
+            }
+            if (cpu_online(cpu)) {
+                kthread_bind(t->task, cpu);
+            }
+        }
+    }
+    if (err) {
+        // Не запущенный поток kthread_stop снимает, не вызывая его функцию
+        goto out_stop;
+    }
+
+    start = ktime_get_ns();
+    for (i = 0; i < nr; i++) {
+        wake_up_process(bench->threads[i].task);
+    }
+
+    // Ожидание убиваемое и под scull_ring_bench_lock не вечное: при
+    // ошибке потоки снимаются, и отчет не пишется
+    err = scull_ring_bench_wait_producers(bench);
+    if (!err) {
+        err = scull_ring_bench_stop_consumers(bench);
+    }
+    if (err) {
+        scull_ring_bench_abort(bench);
+        goto out_stop;
+    }
+
+    for (i = 0; i < nr; i++) {
+        t = &bench->threads[i];
+        if (!err) {
+            err = t->err;
+        }
+        if (i < cfg->producers) {
+            written += t->messages;
+        } else {
+            consumed += t->messages;
+        }
+        end = max(end, t->end_ns);
+    }
+
+    elapsed = end > start ? end - start : 1;
+    wakeups = atomic_long_read(&buf->read_blocked) + atomic_long_read(&buf->write_blocked);
+    scnprintf(scull_ring_bench_result, sizeof(scull_ring_bench_result),
+              "mode 0x%x size %u msg %u batch %u producers %u consumers %u\n"
+              "records_written %lu records_read %lu dropped %lu elapsed_ns %llu\n"
+              "ns_per_record %llu\n"
+              "wakeups %lu wakeups_per_sec %llu\n"
+              "contended_rd %lu contended_wr %lu\n"
+              "error %d\n",
+              cfg->flags, cfg->size, cfg->msg, cfg->batch, cfg->producers, cfg->consumers,
+              written, consumed, atomic_long_read(&buf->dropped), elapsed,
+              written ? div64_u64(elapsed, written) : 0,
+              wakeups, div64_u64((u64)wakeups * NSEC_PER_SEC, elapsed),
+              atomic_long_read(&buf->rd.contended), atomic_long_read(&buf->wr.contended),
+              err);
+    printk(KERN_INFO "scull_ring: bench mode 0x%x: %lu records in %llu ns\n",
+           cfg->flags, written, elapsed);
+
+out_stop:
+    for (i = 0; i < nr; i++) {
+        t = &bench->threads[i];
+        if (!t->bench) {
+            break;  // До этого потока создание не дошло
+        }
+        if (t->task) {
+            kthread_stop(t->task);
+        }
+        scull_ring_unsubscribe(buf, &t->rf);
+        kvfree(t->data);
+    }
+    scull_ring_buffer_cleanup(buf);
+out_free:
+    kfree(bench->poison);
+    kfree(bench->msg);
+    kfree(bench->threads);
+    kfree(buf);
+    return err;
+}
+
+/**
+ * Запись в debugfs scull_ring/bench: разбор параметров и синхронный прогон
+ */
+static ssize_t scull_ring_bench_write_file(struct file *filp, const char __user *ubuf,
+                                           size_t count, loff_t *ppos) {
+    struct scull_ring_bench *bench;
+    char *cmd;
+    int err;
+
+    if (count >= SCULL_RING_BENCH_CMD_SIZE) {
+        return -EINVAL;
+    }
+    cmd = memdup_user_nul(ubuf, count);
+    if (IS_ERR(cmd)) {
+        return PTR_ERR(cmd);
+    }
+    bench = kzalloc(sizeof(*bench), GFP_KERNEL);
+    if (!bench) {
+        kfree(cmd);
+        return -ENOMEM;
+    }
+
+    // По умолчанию - SPSC в режиме записей
+    bench->cfg.records = 1000000;
+    bench->cfg.size = 65536;
+    bench->cfg.flags = SCULL_RING_F_RECORD;
+    bench->cfg.msg = 64;
+    bench->cfg.batch = 1;
+    bench->cfg.producers = 1;
+    bench->cfg.consumers = 1;
+    err = scull_ring_bench_parse(&bench->cfg, cmd);
+    kfree(cmd);
+
+    if (!err) {
+        if (mutex_lock_interruptible(&scull_ring_bench_lock)) {
+            err = -ERESTARTSYS;
+        } else {
+            err = scull_ring_bench_run(bench);
+            mutex_unlock(&scull_ring_bench_lock);
+        }
+    }
+    kfree(bench);
+    return err ? err : count;
+}
+
+/**
+ * Чтение debugfs scull_ring/bench: отчет последнего прогона
+ * (во время прогона ждет его окончания)
+ */
+static ssize_t scull_ring_bench_read_file(struct file *filp, char __user *ubuf,
+                                          size_t count, loff_t *ppos) {
+    ssize_t ret;
+
+    if (mutex_lock_interruptible(&scull_ring_bench_lock)) {
+        return -ERESTARTSYS;
+    }
+    ret = simple_read_from_buffer(ubuf, count, ppos, scull_ring_bench_result,
+                                  strlen(scull_ring_bench_result));
+    mutex_unlock(&scull_ring_bench_lock);
+    return ret;
+}
+
+static const struct file_operations scull_ring_bench_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .read = scull_ring_bench_read_file,
+    .write = scull_ring_bench_write_file,
+    .llseek = default_llseek,
+};
+
 /**
  * Инициализация модуля драйвера
  * 
  * Регистрирует устройства, выделяет ресурсы, инициализирует структуры данных.
- * Создает три устройства: /dev/scull_ring0, /dev/scull_ring1, /dev/scull_ring2
+ * Создает scull_ring_nr_devs устройств (по умолчанию три: /dev/scull_ring0,
+ * /dev/scull_ring1, /dev/scull_ring2) и управляющее /dev/scull_ring_ctl.
  */
 static int __init scull_ring_init(void) {
     dev_t dev = 0;
     int err, i;
 
-    // Регистрация диапазона символьных устройств
+    // Позиции растут свободно, поэтому размер обязан делить 2^32
+    BUILD_BUG_ON_NOT_POWER_OF_2(SCULL_RING_BUFFER_SIZE);
+
+    if (scull_ring_nr_devs > SCULL_RING_MAX_DEVS) {
+        printk(KERN_ERR "scull_ring: scull_ring_nr_devs must be <= %d\n", SCULL_RING_MAX_DEVS);
+        return -EINVAL;
+    }
+
+    // Регистрация диапазона символьных устройств (весь диапазон младших номеров)
     if (scull_ring_major) {
         // Использование указанного основного номера
         dev = MKDEV(scull_ring_major, 0);
-        err = register_chrdev_region(dev, SCULL_RING_NR_DEVS, DEVICE_NAME);
+        err = register_chrdev_region(dev, SCULL_RING_MAX_DEVS, DEVICE_NAME);
     } else {
         // Автоматическое выделение основного номера
-        err = alloc_chrdev_region(&dev, 0, SCULL_RING_NR_DEVS, DEVICE_NAME);
+        err = alloc_chrdev_region(&dev, 0, SCULL_RING_MAX_DEVS, DEVICE_NAME);
         scull_ring_major = MAJOR(dev);
     }
     if (err < 0) {
@@ -579,50 +3554,53 @@ static int __init scull_ring_init(void) {
         return err;
     }
 
-    // Инициализация каждого из трех устройств
-    for (i = 0; i < SCULL_RING_NR_DEVS; i++) {
-        struct scull_ring_dev *scull_dev = &scull_ring_devices[i];
-        
-        // Выделение памяти для структуры буфера
-        scull_dev->ring_buf = kmalloc(sizeof(struct scull_ring_buffer), GFP_KERNEL);
-        if (!scull_dev->ring_buf) {
-            err = -ENOMEM;
-            goto fail;
-        }
-        
-        // Инициализация кольцевого буфера
-        err = scull_ring_buffer_init(scull_dev->ring_buf, SCULL_RING_BUFFER_SIZE);
-        if (err) {
-            kfree(scull_dev->ring_buf);
-            goto fail;
-        }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    scull_ring_class = class_create(DEVICE_NAME);
+#else
+    scull_ring_class = class_create(THIS_MODULE, DEVICE_NAME);
+#endif
+    if (IS_ERR(scull_ring_class)) {
+        err = PTR_ERR(scull_ring_class);
+        goto fail_region;
+    }
+    scull_ring_class->devnode = scull_ring_devnode;
 
-        // Инициализация и регистрация символьного устройства
-        cdev_init(&scull_dev->cdev, &scull_ring_fops);
-        scull_dev->cdev.owner = THIS_MODULE;
-        err = cdev_add(&scull_dev->cdev, MKDEV(scull_ring_major, i), 1);
+    // Каталог телеметрии; ошибки debugfs не мешают работе драйвера
+    scull_ring_debugfs = debugfs_create_dir(DEVICE_NAME, NULL);
+    debugfs_create_file("bench", 0600, scull_ring_debugfs, NULL, &scull_ring_bench_fops);
+
+    // Инициализация начальных устройств
+    mutex_lock(&scull_ring_devices_lock);
+    for (i = 0; i < scull_ring_nr_devs; i++) {
+        err = scull_ring_dev_create(i, scull_ring_sizes[i], scull_ring_flags[i], scull_ring_nodes[i]);
         if (err) {
-            printk(KERN_NOTICE "Error %d adding scull_ring%d", err, i);
-            scull_ring_buffer_cleanup(scull_dev->ring_buf);
-            kfree(scull_dev->ring_buf);
-            goto fail;
+            break;
         }
     }
+    mutex_unlock(&scull_ring_devices_lock);
+    if (err) {
+        goto fail;
+    }
+
+    // Управляющее устройство регистрируется последним: оно видит все кольца
+    err = misc_register(&scull_ring_ctl);
+    if (err) {
+        printk(KERN_WARNING "scull_ring: can't register %s\n", SCULL_RING_CTL_NAME);
+        goto fail;
+    }
 
     // Успешная загрузка модуля
     printk(KERN_INFO "scull_ring: driver loaded with major %d\n", scull_ring_major);
-    printk(KERN_INFO "scull_ring: buffer size is %d bytes\n", SCULL_RING_BUFFER_SIZE);
     printk(KERN_ALERT "The process is \"%s\" (pid %i) \n", current->comm, current->pid);
     return 0;
 
 fail:
     // Очистка при ошибке инициализации
-    while (--i >= 0) {
-        cdev_del(&scull_ring_devices[i].cdev);
-        scull_ring_buffer_cleanup(scull_ring_devices[i].ring_buf);
-        kfree(scull_ring_devices[i].ring_buf);
-    }
-    unregister_chrdev_region(MKDEV(scull_ring_major, 0), SCULL_RING_NR_DEVS);
+    scull_ring_destroy_all();
+    debugfs_remove_recursive(scull_ring_debugfs);
+    class_destroy(scull_ring_class);
+fail_region:
+    unregister_chrdev_region(MKDEV(scull_ring_major, 0), SCULL_RING_MAX_DEVS);
     return err;
 }
 
@@ -632,18 +3610,16 @@ fail:
  * Освобождает все ресурсы, удаляет устройства, очищает память.
  */
 static void __exit scull_ring_exit(void) {
-    int i;
-    dev_t dev = MKDEV(scull_ring_major, 0);
+    // Управляющее устройство ссылается на кольца - удаляем его первым
+    misc_deregister(&scull_ring_ctl);
 
     // Очистка всех устройств
-    for (i = 0; i < SCULL_RING_NR_DEVS; i++) {
-        cdev_del(&scull_ring_devices[i].cdev);
-        scull_ring_buffer_cleanup(scull_ring_devices[i].ring_buf);
-        kfree(scull_ring_devices[i].ring_buf);
-    }
+    scull_ring_destroy_all();
+    debugfs_remove_recursive(scull_ring_debugfs);
+    class_destroy(scull_ring_class);
 
     // Освобождение диапазона устройств
-    unregister_chrdev_region(dev, SCULL_RING_NR_DEVS);
+    unregister_chrdev_region(MKDEV(scull_ring_major, 0), SCULL_RING_MAX_DEVS);
     printk(KERN_INFO "scull_ring: driver unloaded\n");
 }
 
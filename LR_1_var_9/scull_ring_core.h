@@ -0,0 +1,816 @@
+// scull_ring_core.h
+// Общий код кольца scull_ring: формат (копирование через границу кольца,
+// разбор сообщений и снимков, запись и извлечение одного сообщения) и
+// протокол сторон (вход без мьютекса и откат на мьютекс, начало и конец
+// чтения и записи, scull_ring_buffer_read/write).
+//
+// Заголовок подключается после определения struct scull_ring_buffer и
+// struct scull_ring_file:
+//   - модулем scull_ring.c (ядро);
+//   - библиотекой user/scull_ring_user.c поверх user/scull_ring_shim.h
+//     (mutex, атомарные операции, wait_var_event и очереди ожидания в
+//     пользовательском пространстве), чтобы гонять тот же код в тестах и
+//     замерах без insmod.
+//
+// Функции формата не знают ни о сторонах, ни об ожидании: вызывающий уже
+// захватил нужную сторону и передает позиции. От буфера им нужны поля
+// data, size, mask, flags и seq; что нужно протоколу сторон, описано
+// перед его разделом.
+#ifndef SCULL_RING_CORE_H
+#define SCULL_RING_CORE_H
+
+/*
+ * Снимок кольца для мониторинга (scull_ring_snapshot). Снимается без
+ * buf->lock, поэтому может отставать от кольца, но внутренне согласован.
+ */
+struct scull_ring_snap {
+    unsigned int read_pos;   // Позиция чтения, с которой начинается копия данных
+    unsigned int data_len;   // Заполненность кольца (в режиме PERCPU - всех подколец)
+    unsigned int size;       // Размер кольца
+    unsigned int flags;      // Режим кольца
+    unsigned int len;        // Скопировано байт данных начиная с read_pos
+};
+
+/**
+ * Копирование из кольца в память ядра с учетом перехода через границу
+ * @buf: указатель на буфер
+ * @pos: позиция в кольце (свободно растущая)
+ * @dst: куда копировать
+ * @len: количество байт (не больше размера кольца)
+ */
+static void scull_ring_peek(struct scull_ring_buffer *buf, unsigned int pos, void *dst, unsigned int len) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int to_end = buf->size - offset;
+
+    if (len > to_end) {
+        memcpy(dst, buf->data + offset, to_end);
+        memcpy((char *)dst + to_end, buf->data, len - to_end);
+    } else {
+        memcpy(dst, buf->data + offset, len);
+    }
+}
+
+/**
+ * Копирование из памяти ядра в кольцо с учетом перехода через границу
+ */
+static void scull_ring_poke(struct scull_ring_buffer *buf, unsigned int pos, const void *src, unsigned int len) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int to_end = buf->size - offset;
+
+    if (len > to_end) {
+        memcpy(buf->data + offset, src, to_end);
+        memcpy(buf->data, (const char *)src + to_end, len - to_end);
+    } else {
+        memcpy(buf->data + offset, src, len);
+    }
+}
+
+/**
+ * Копирование из кольца в пользовательское пространство
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_copy_to_user(struct scull_ring_buffer *buf, unsigned int pos, char __user *user_buf, unsigned int len) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int to_end = buf->size - offset;
+
+    if (len > to_end) {
+        // Две операции копирования: от позиции до конца и с начала буфера
+        if (copy_to_user(user_buf, buf->data + offset, to_end) ||
+            copy_to_user(user_buf + to_end, buf->data, len - to_end)) {
+            return -EFAULT;
+        }
+        return 0;
+    }
+    // Одна операция копирования
+    return copy_to_user(user_buf, buf->data + offset, len) ? -EFAULT : 0;
+}
+
+/**
+ * Копирование из пользовательского пространства в кольцо
+ * Возвращает 0 или -EFAULT
+ */
+static int scull_ring_copy_from_user(struct scull_ring_buffer *buf, unsigned int pos, const char __user *user_buf, unsigned int len) {
+    unsigned int offset = pos & buf->mask;
+    unsigned int to_end = buf->size - offset;
+
+    if (len > to_end) {
+        // Две операции копирования: от позиции до конца и с начала буфера
+        if (copy_from_user(buf->data + offset, user_buf, to_end) ||
+            copy_from_user(buf->data, user_buf + to_end, len - to_end)) {
+            return -EFAULT;
+        }
+        return 0;
+    }
+    // Одна операция копирования
+    return copy_from_user(buf->data + offset, user_buf, len) ? -EFAULT : 0;
+}
+
+/**
+ * Поиск нуль-терминатора в кольцевом буфере
+ * @buf: указатель на буфер
+ * @start_pos: начальная позиция поиска
+ * @max_len: максимальная длина поиска (не больше доступных данных)
+ * Возвращает длину сообщения включая нуль-терминатор, или -1 если не найден
+ * 
+ * Эта функция необходима для обработки строк в кольцевом буфере, так как
+ * сообщения разделяются нуль-терминаторами.
+ */
+static int find_null_terminator(struct scull_ring_buffer *buf, unsigned int start_pos, int max_len) {
+    unsigned int pos = start_pos;
+    int bytes_checked = 0;
+    
+    // Поиск нуль-терминатора в пределах max_len
+    while (bytes_checked < max_len) {
+        if (buf->data[pos & buf->mask] == '\0') {
+            return bytes_checked + 1; // Возвращаем длину включая нуль-терминатор
+        }
+        pos++;  // Позиция свободно растет, индекс берется по модулю размера
+        bytes_checked++;
+    }
+    return -1; // Нуль-терминатор не найден
+}
+
+/**
+ * Границы следующего сообщения в кольце
+ * @buf: указатель на буфер
+ * @pos: позиция начала сообщения
+ * @avail: количество данных от pos до write_pos
+ * @payload_pos: выход - позиция первого байта данных сообщения
+ * @payload_len: выход - длина данных сообщения (без '\0' и заголовка)
+ * Возвращает полную длину сообщения в кольце, или -1 если сообщение неполное
+ *
+ * В режиме записей длина берется из заголовка без сканирования данных,
+ * в режиме потока байт ищется нуль-терминатор.
+ */
+static int scull_ring_next_message(struct scull_ring_buffer *buf, unsigned int pos, int avail,
+                                   unsigned int *payload_pos, unsigned int *payload_len) {
+    struct scull_ring_rec_hdr hdr;
+    int message_len;
+
+    if (buf->flags & SCULL_RING_F_RECORD) {
+        if (avail < (int)sizeof(hdr)) {
+            return -1;
+        }
+        scull_ring_peek(buf, pos, &hdr, sizeof(hdr));
+        if (hdr.len > avail - sizeof(hdr)) {
+            return -1;
+        }
+        *payload_pos = pos + sizeof(hdr);
+        *payload_len = hdr.len;
+        return sizeof(hdr) + hdr.len;
+    }
+
+    message_len = find_null_terminator(buf, pos, avail);
+    if (message_len < 0) {
+        return -1;
+    }
+    *payload_pos = pos;
+    *payload_len = message_len - 1;
+    return message_len;
+}
+
+/**
+ * Границы следующего сообщения в копии снимка
+ * @snap: снимок кольца
+ * @data: скопированные данные снимка
+ * @pos: смещение начала сообщения в data
+ * @desc: выход - положение данных сообщения в data и метка времени
+ * Возвращает полную длину сообщения, или -1 если оно не попало в копию целиком
+ */
+static int scull_ring_snap_next(const struct scull_ring_snap *snap, const char *data, unsigned int pos,
+                                struct scull_ring_rec_desc *desc) {
+    struct scull_ring_rec_hdr hdr;
+    unsigned int avail = snap->len - pos;
+    const char *end;
+
+    if (snap->flags & SCULL_RING_F_RECORD) {
+        if (avail < sizeof(hdr)) {
+            return -1;
+        }
+        memcpy(&hdr, data + pos, sizeof(hdr));
+        if (hdr.len > avail - sizeof(hdr)) {
+            return -1;
+        }
+        desc->offset = pos + sizeof(hdr);
+        desc->len = hdr.len;
+        desc->tstamp_ns = hdr.tstamp_ns;
+        return sizeof(hdr) + hdr.len;
+    }
+
+    end = memchr(data + pos, '\0', avail);
+    if (!end) {
+        return -1;
+    }
+    desc->offset = pos;
+    desc->len = end - (data + pos);
+    desc->tstamp_ns = 0;
+    return desc->len + 1;
+}
+
+/**
+ * Извлечение всех сообщений из снимка для отладки через IOCTL
+ * @snap: снимок кольца
+ * @data: скопированные данные снимка (snap->len байт от snap->read_pos)
+ * @output: буфер для результата
+ * @output_size: размер выходного буфера
+ * Возвращает количество извлеченных сообщений
+ * 
+ * Функция используется командой PEEK_BUFFER для показа содержимого буфера
+ * без извлечения данных (только чтение). Разбор идет по копии, поэтому
+ * форматирование не держит кольцо.
+ */
+static int extract_messages(const struct scull_ring_snap *snap, const char *data, char *output, int output_size) {
+    struct scull_ring_rec_desc desc;
+    int data_len = snap->data_len;
+    int avail = snap->len;
+    int bytes_processed = 0;
+    int message_count = 0;
+    int output_used = 0;
+    
+    // Если буфер пуст
+    if (data_len == 0) {
+        snprintf(output, output_size, "Empty");
+        return 0;
+    }
+    
+    // Начало вывода в формате списка
+    output_used += snprintf(output + output_used, output_size - output_used, "[");
+    
+    // Извлечение всех полных сообщений из скопированной части
+    while (bytes_processed < avail && output_used < output_size - 20) {
+        // Поиск следующего сообщения (по заголовку или до нуль-терминатора)
+        int message_len = scull_ring_snap_next(snap, data, bytes_processed, &desc);
+        if (message_len < 0) {
+            // Полное сообщение не найдено - остались только частичные данные
+            break;
+        }
+        
+        // Извлечение начала сообщения
+        char message[20];
+        unsigned int msg_bytes_copied = 0;
+        for (unsigned int i = 0; i < desc.len && i < 19; i++) {
+            message[i] = data[desc.offset + i];
+            msg_bytes_copied++;
+            
+            // Защита от случайных нуль-терминаторов в середине сообщения
+            if (message[i] == '\0') break;
+        }
+        message[msg_bytes_copied] = '\0';
+        
+        // Добавление сообщения в выходной буфер с разделителями
+        if (message_count > 0) {
+            output_used += snprintf(output + output_used, output_size - output_used, ", ");
+        }
+        output_used += snprintf(output + output_used, output_size - output_used, "%s", message);
+        
+        // Переход к следующему сообщению
+        bytes_processed += message_len;
+        message_count++;
+    }
+    
+    // Завершение форматированного вывода
+    output_used += snprintf(output + output_used, output_size - output_used, "]");
+    
+    // Информация о непоместившихся данных
+    if (bytes_processed < data_len) {
+        output_used += snprintf(output + output_used, output_size - output_used, 
+                              " +%db more", data_len - bytes_processed);
+    }
+    
+    return message_count;
+}
+
+/**
+ * Заполнение заголовка записи в кольце
+ */
+static void scull_ring_put_header(struct scull_ring_buffer *buf, unsigned int pos, unsigned int len) {
+    struct scull_ring_rec_hdr hdr;
+
+    // Заголовок записи: длина и, при необходимости, номер и метка времени
+    hdr.len = len;
+    if (buf->flags & SCULL_RING_F_TIMESTAMP) {
+        hdr.seq = atomic_inc_return(&buf->seq);
+        hdr.tstamp_ns = ktime_get_ns();
+    } else {
+        hdr.seq = 0;
+        hdr.tstamp_ns = 0;
+    }
+    scull_ring_poke(buf, pos, &hdr, sizeof(hdr));
+}
+
+/**
+ * Сколько свободного места нужно писателю, чтобы начать запись
+ * @buf: указатель на буфер
+ * @count: длина сообщения
+ * @hdr_len: выход - длина заголовка записи (0 в режиме потока байт)
+ * Возвращает нужное место или -EMSGSIZE, если запись не поместится никогда
+ *
+ * Запись ждет места под себя целиком вместе с заголовком. Поток байт
+ * начинает писать, как только есть хоть один байт (сообщение усекается);
+ * в режиме OVERWRITE освобождается место под все сообщение.
+ */
+static int scull_ring_write_need(struct scull_ring_buffer *buf, size_t count, unsigned int *hdr_len) {
+    *hdr_len = (buf->flags & SCULL_RING_F_RECORD) ? sizeof(struct scull_ring_rec_hdr) : 0;
+    if (*hdr_len) {
+        if (count > buf->size - *hdr_len) {
+            return -EMSGSIZE;
+        }
+        return *hdr_len + count;
+    }
+    if (buf->flags & SCULL_RING_F_OVERWRITE) {
+        // Сообщение длиннее кольца все равно будет усечено до его размера
+        return clamp_t(size_t, count, 1, buf->size);
+    }
+    return 1;
+}
+
+/**
+ * Запись одного сообщения в кольцо (позиции не меняются)
+ * @buf: указатель на буфер
+ * @write_pos: позиция записи
+ * @hdr_len: длина заголовка (из scull_ring_write_need)
+ * @user_buf: данные сообщения
+ * @count: длина данных (уже ограничена свободным местом)
+ * Возвращает 0 или -EFAULT
+ *
+ * Вызывающий публикует write_pos + hdr_len + count сам.
+ */
+static int scull_ring_put_message(struct scull_ring_buffer *buf, unsigned int write_pos, unsigned int hdr_len,
+                                  const char __user *user_buf, unsigned int count) {
+    if (scull_ring_copy_from_user(buf, write_pos + hdr_len, user_buf, count)) {
+        return -EFAULT;
+    }
+    if (hdr_len) {
+        scull_ring_put_header(buf, write_pos, count);
+    }
+    return 0;
+}
+
+/**
+ * Извлечение одного сообщения из кольца (позиции не меняются)
+ * @buf: указатель на буфер
+ * @read_pos: позиция чтения
+ * @data_len: количество данных от read_pos (> 0)
+ * @user_buf: куда копировать
+ * @count: размер user_buf
+ * @meta: класть перед данными struct scull_ring_rec_hdr (count не меньше заголовка)
+ * @bytes_read: выход - сколько байт данных отдано (без заголовка)
+ * Возвращает, на сколько сдвинуть read_pos, или код ошибки
+ *
+ * В режиме записей отдается ровно одна запись; если она не помещается
+ * в count, остаток отбрасывается (как у датаграмм). С meta в режиме
+ * записей заголовок берется из кольца (len - полная длина записи), в
+ * потоке байт заполняется только длина.
+ */
+static int scull_ring_take_message(struct scull_ring_buffer *buf, unsigned int read_pos, int data_len,
+                                   char __user *user_buf, size_t count, bool meta, int *bytes_read) {
+    struct scull_ring_rec_hdr hdr;
+    unsigned int hdr_len = meta ? sizeof(hdr) : 0;
+    unsigned int payload_pos, payload_len;
+    int message_len;
+
+    count -= hdr_len;
+
+    // Поиск полного сообщения (по заголовку или до нуль-терминатора)
+    message_len = scull_ring_next_message(buf, read_pos, data_len, &payload_pos, &payload_len);
+    if (buf->flags & SCULL_RING_F_RECORD) {
+        // Писатели публикуют записи целиком, поэтому неполная запись
+        // означает порчу кольца через mmap()
+        if (message_len < 0) {
+            return -EIO;
+        }
+        *bytes_read = min_t(size_t, payload_len, count);
+        if (meta) {
+            scull_ring_peek(buf, read_pos, &hdr, sizeof(hdr));
+        }
+    } else {
+        if (message_len < 0) {
+            // Полное сообщение не найдено - читаем доступные данные
+            message_len = data_len;
+        }
+        // Ограничиваем чтение размером пользовательского буфера
+        message_len = min_t(size_t, message_len, count);
+        payload_pos = read_pos;
+        *bytes_read = message_len;
+        hdr.len = message_len;
+        hdr.seq = 0;
+        hdr.tstamp_ns = 0;
+    }
+
+    // Копирование данных из кольцевого буфера в пользовательское пространство
+    if ((meta && copy_to_user(user_buf, &hdr, hdr_len)) ||
+        scull_ring_copy_to_user(buf, payload_pos, user_buf + hdr_len, *bytes_read)) {
+        return -EFAULT;
+    }
+    return message_len;
+}
+
+/*
+ * Протокол сторон: путь без мьютекса для единственного читателя и
+ * единственного писателя, откат на buf->lock при конкуренции, ожидание
+ * данных и места, запись и чтение одного сообщения.
+ *
+ * Кроме полей формата нужны minor, ctrl, lock, rd, wr (struct
+ * scull_ring_side: inflight, locked, contended), read_count, read_bytes,
+ * write_count, write_bytes и struct scull_ring_file с полями cursor,
+ * lapped и read_meta. Ожидание, отметки времени, затирание, BROADCAST и
+ * пробуждение другой стороны у модуля и user/ свои - включающий
+ * определяет функции, объявленные ниже, и точки трассировки
+ * trace_scull_ring_block, trace_scull_ring_unblock и
+ * trace_scull_ring_lock_fallback.
+ */
+
+// Режимы, в которых позициями управляет не только пара читатель/писатель:
+// путь без мьютекса и mmap() в них запрещены
+#define SCULL_RING_LOCKED_MODES (SCULL_RING_F_OVERWRITE | SCULL_RING_F_BROADCAST | SCULL_RING_F_PERCPU)
+
+static unsigned int scull_ring_data_len(struct scull_ring_buffer *buf);
+static unsigned int scull_ring_broadcast_advance(struct scull_ring_buffer *buf);
+static void scull_ring_mark_read(struct scull_ring_buffer *buf, unsigned int read_pos);
+static void scull_ring_mark_write(struct scull_ring_buffer *buf, unsigned int write_pos);
+static int scull_ring_wait_readable(struct scull_ring_buffer *buf, struct scull_ring_file *rf);
+static int scull_ring_wait_writable(struct scull_ring_buffer *buf, unsigned int need);
+static unsigned int scull_ring_overwrite(struct scull_ring_buffer *buf, unsigned int write_pos, unsigned int need);
+// После освобождения стороны: статистика и пробуждение другой стороны
+static void scull_ring_read_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked);
+static void scull_ring_write_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked);
+
+/**
+ * Вход в операцию одной стороны кольца
+ * @buf: указатель на буфер
+ * @side: сторона (buf->rd или buf->wr)
+ * @locked: выход - true, если операция идет под мьютексом
+ * Возвращает 0 или -ERESTARTSYS
+ *
+ * Если на стороне больше никто не работает, операция выполняется без
+ * мьютекса: с другой стороной ее синхронизируют acquire/release на
+ * read_pos/write_pos. Иначе захватывается buf->lock, новые входы без
+ * блокировки запрещаются через side->locked, и мы дожидаемся завершения
+ * уже начатой операции без блокировки.
+ */
+static int scull_ring_side_enter(struct scull_ring_buffer *buf, struct scull_ring_side *side, bool *locked) {
+    bool contended = true;
+
+    // atomic_inc_return - полный барьер: либо мы увидим locked, либо
+    // владелец мьютекса увидит наш inflight
+    if (atomic_inc_return(&side->inflight) == 1 && !atomic_read_acquire(&side->locked)) {
+        // Режим меняется под scull_ring_lock_all, который ждет inflight == 0,
+        // поэтому здесь buf->flags уже не изменится
+        if (!(buf->flags & SCULL_RING_LOCKED_MODES)) {
+            *locked = false;
+            return 0;
+        }
+        contended = false;
+    }
+
+    // На стороне есть другой процесс или режим требует мьютекса - откат на мьютекс
+    if (atomic_dec_return(&side->inflight) == 0 && atomic_read(&side->locked)) {
+        wake_up_var(&side->inflight);
+    }
+    if (contended) {
+        atomic_long_inc(&side->contended);
+        trace_scull_ring_lock_fallback(buf->minor, side == &buf->wr);
+    }
+
+    if (mutex_lock_interruptible(&buf->lock)) {
+        return -ERESTARTSYS;
+    }
+    atomic_inc(&side->locked);
+    smp_mb__after_atomic();
+    wait_var_event(&side->inflight, atomic_read_acquire(&side->inflight) == 0);
+
+    *locked = true;
+    return 0;
+}
+
+/**
+ * Выход из операции одной стороны кольца (парная к scull_ring_side_enter)
+ */
+static void scull_ring_side_exit(struct scull_ring_buffer *buf, struct scull_ring_side *side, bool locked) {
+    if (locked) {
+        // Сторона, вошедшая без мьютекса после нас, должна видеть все,
+        // что сделано под ним (парно к atomic_read_acquire в side_enter)
+        smp_mb__before_atomic();
+        atomic_dec(&side->locked);
+        mutex_unlock(&buf->lock);
+        return;
+    }
+
+    // Будим владельца мьютекса, если он ждет окончания нашей операции
+    if (atomic_dec_return(&side->inflight) == 0 && atomic_read(&side->locked)) {
+        wake_up_var(&side->inflight);
+    }
+}
+
+/**
+ * Захват кольца целиком для смены режима или размера
+ * Берет мьютекс, запрещает обеим сторонам работу без мьютекса и ждет
+ * завершения уже начатых операций без блокировки.
+ * Возвращает 0 или -ERESTARTSYS
+ */
+static int scull_ring_lock_all(struct scull_ring_buffer *buf) {
+    if (mutex_lock_interruptible(&buf->lock)) {
+        return -ERESTARTSYS;
+    }
+    atomic_inc(&buf->rd.locked);
+    atomic_inc(&buf->wr.locked);
+    smp_mb__after_atomic();
+    wait_var_event(&buf->rd.inflight, atomic_read_acquire(&buf->rd.inflight) == 0);
+    wait_var_event(&buf->wr.inflight, atomic_read_acquire(&buf->wr.inflight) == 0);
+    return 0;
+}
+
+static void scull_ring_unlock_all(struct scull_ring_buffer *buf) {
+    smp_mb__before_atomic();
+    atomic_dec(&buf->wr.locked);
+    atomic_dec(&buf->rd.locked);
+    mutex_unlock(&buf->lock);
+}
+
+/**
+ * Начало операции чтения: захват стороны читателей и ожидание данных
+ * @buf: указатель на буфер
+ * @rf: файл читателя
+ * @nonblock: не спать на пустом кольце, а вернуть -EAGAIN
+ * @locked: выход - сторона захвачена под мьютексом
+ * @read_pos: выход - текущая позиция чтения
+ * Возвращает количество данных в кольце (> 0) или код ошибки
+ *
+ * Реализует блокирующее чтение: если данных нет, процесс блокируется
+ * до появления данных или получения сигнала. При успехе сторона
+ * остается захваченной до scull_ring_read_end. В режиме BROADCAST
+ * читается с позиции файла; подписчик, которого обогнал писатель,
+ * получает -EPIPE и переносится на самое старое сообщение.
+ */
+static int scull_ring_read_begin(struct scull_ring_buffer *buf, struct scull_ring_file *rf, bool nonblock,
+                                 bool *locked, unsigned int *read_pos) {
+    unsigned int data_len;
+    int ret;
+
+    for (;;) {
+        // Захват стороны читателей (без мьютекса, если читатель один)
+        if (scull_ring_side_enter(buf, &buf->rd, locked)) {
+            return -ERESTARTSYS;
+        }
+
+        if (buf->flags & SCULL_RING_F_BROADCAST) {
+            if ((int)(rf->cursor - buf->ctrl->read_pos) < 0) {
+                rf->cursor = buf->ctrl->read_pos;
+                rf->lapped++;
+                scull_ring_side_exit(buf, &buf->rd, *locked);
+                return -EPIPE;
+            }
+            *read_pos = rf->cursor;
+        } else {
+            *read_pos = buf->ctrl->read_pos;
+        }
+        data_len = smp_load_acquire(&buf->ctrl->write_pos) - *read_pos;
+        if (unlikely(data_len > buf->size)) {
+            // Позиции испорчены процессом, отобразившим кольцо через mmap()
+            // (write_pos позади read_pos дает здесь огромную длину)
+            scull_ring_side_exit(buf, &buf->rd, *locked);
+            return -EIO;
+        }
+        if (data_len > 0) {
+            return data_len;
+        }
+        if (nonblock) {
+            scull_ring_side_exit(buf, &buf->rd, *locked);
+            return -EAGAIN;
+        }
+
+        // БЛОКИРОВКА 1: Читатель ждет данных (буфер пустой)
+        trace_scull_ring_block(buf->minor, false, 0);
+        
+        // Освобождаем сторону перед блокировкой (чтобы писатели могли работать)
+        scull_ring_side_exit(buf, &buf->rd, *locked);
+        
+        // Блокировка в очереди ожидания до появления данных
+        ret = scull_ring_wait_readable(buf, rf);
+        trace_scull_ring_unblock(buf->minor, false, scull_ring_data_len(buf), ret);
+        if (ret) {
+            return ret;
+        }
+    }
+}
+
+/**
+ * Завершение операции чтения
+ * @buf: указатель на буфер
+ * @rf: файл читателя
+ * @read_pos: новая позиция чтения
+ * @messages: количество прочитанных сообщений
+ * @bytes: количество байт, отданных процессу
+ * @locked: сторона захвачена под мьютексом
+ *
+ * Публикует позицию, освобождает сторону и передает пачку
+ * scull_ring_read_done: писателей будят один раз на всю пачку сообщений.
+ */
+static void scull_ring_read_end(struct scull_ring_buffer *buf, struct scull_ring_file *rf, unsigned int read_pos,
+                                int messages, int bytes, bool locked) {
+    if (buf->flags & SCULL_RING_F_BROADCAST) {
+        // Место освобождается, только когда сообщение прочитали все подписчики
+        rf->cursor = read_pos;
+        read_pos = scull_ring_broadcast_advance(buf);
+    } else {
+        // Публикация новой позиции чтения: место можно переиспользовать
+        smp_store_release(&buf->ctrl->read_pos, read_pos);
+    }
+
+    // Отметки снимает только владелец стороны читателей
+    scull_ring_mark_read(buf, read_pos);
+
+    // Увеличение счетчика операций чтения
+    atomic_add(messages, &buf->read_count);
+    atomic64_add(bytes, &buf->read_bytes);
+    scull_ring_side_exit(buf, &buf->rd, locked);
+    scull_ring_read_done(buf, messages, bytes, locked);
+}
+
+/**
+ * Начало операции записи: захват стороны писателей и ожидание места
+ * @buf: указатель на буфер
+ * @count: длина первого записываемого сообщения
+ * @nonblock: не спать на полном кольце, а вернуть -EAGAIN
+ * @locked: выход - сторона захвачена под мьютексом
+ * @write_pos: выход - текущая позиция записи
+ * @hdr_len: выход - длина заголовка записи (0 в режиме потока байт)
+ * Возвращает количество свободного места или код ошибки
+ *
+ * Реализует блокирующую запись: если буфер полон, процесс блокируется
+ * до освобождения места или получения сигнала. В режиме записей
+ * писатель ждет места под всю запись с заголовком и никогда не усекает
+ * ее, поэтому читатель не может потерять границу. В режиме OVERWRITE
+ * писатель не ждет, а затирает старейшие сообщения под все сообщение.
+ */
+static int scull_ring_write_begin(struct scull_ring_buffer *buf, size_t count, bool nonblock,
+                                  bool *locked, unsigned int *write_pos, unsigned int *hdr_len) {
+    unsigned int available;
+    unsigned int need;
+    int ret;
+
+    for (;;) {
+        // Захват стороны писателей (без мьютекса, если писатель один)
+        if (scull_ring_side_enter(buf, &buf->wr, locked)) {
+            return -ERESTARTSYS;
+        }
+
+        // Сколько места нужно, чтобы начать запись. Режим и размер могли
+        // смениться, пока процесс спал, поэтому считаем заново на каждом шаге
+        ret = scull_ring_write_need(buf, count, hdr_len);
+        if (ret < 0) {
+            scull_ring_side_exit(buf, &buf->wr, *locked);
+            return ret;
+        }
+        need = ret;
+
+        // Расчет доступного места для записи
+        *write_pos = buf->ctrl->write_pos;
+        available = buf->size - (*write_pos - smp_load_acquire(&buf->ctrl->read_pos));
+        if (unlikely(available > buf->size)) {
+            // Позиции испорчены процессом, отобразившим кольцо через mmap()
+            scull_ring_side_exit(buf, &buf->wr, *locked);
+            return -EIO;
+        }
+        if (available >= need) {
+            return available;
+        }
+        if (buf->flags & SCULL_RING_F_OVERWRITE) {
+            return scull_ring_overwrite(buf, *write_pos, need);
+        }
+        if (nonblock) {
+            scull_ring_side_exit(buf, &buf->wr, *locked);
+            return -EAGAIN;
+        }
+
+        // БЛОКИРОВКА 2: Писатель ждет места (буфер полный)
+        trace_scull_ring_block(buf->minor, true, buf->size - available);
+        
+        // Освобождение стороны перед блокировкой (чтобы читатели могли освободить место)
+        scull_ring_side_exit(buf, &buf->wr, *locked);
+        
+        // Блокировка в очереди ожидания до появления свободного места
+        ret = scull_ring_wait_writable(buf, need);
+        trace_scull_ring_unblock(buf->minor, true, scull_ring_data_len(buf), ret);
+        if (ret) {
+            return ret;
+        }
+    }
+}
+
+/**
+ * Завершение операции записи
+ * @buf: указатель на буфер
+ * @write_pos: новая позиция записи
+ * @messages: количество записанных сообщений
+ * @bytes: количество байт, принятых от процесса
+ * @locked: сторона захвачена под мьютексом
+ */
+static void scull_ring_write_end(struct scull_ring_buffer *buf, unsigned int write_pos, int messages, int bytes, bool locked) {
+    // Отметка ставится до публикации, чтобы читатель не забрал пачку раньше нее
+    scull_ring_mark_write(buf, write_pos);
+
+    // Публикация новой позиции записи: данные становятся видны читателю
+    smp_store_release(&buf->ctrl->write_pos, write_pos);
+
+    // Увеличение счетчика операций записи
+    atomic_add(messages, &buf->write_count);
+    atomic64_add(bytes, &buf->write_bytes);
+    scull_ring_side_exit(buf, &buf->wr, locked);
+    scull_ring_write_done(buf, messages, bytes, locked);
+}
+
+/**
+ * Операция чтения из кольцевого буфера
+ * @buf: указатель на буфер
+ * @rf: файл читателя
+ * @user_buf: буфер пользовательского пространства
+ * @count: запрошенное количество байт
+ * @nonblock: файл открыт с O_NONBLOCK
+ * Возвращает количество прочитанных байт или код ошибки
+ * 
+ * Читает одно сообщение. Если данных нет, процесс блокируется до их
+ * появления или получения сигнала; с O_NONBLOCK возвращается -EAGAIN.
+ *
+ * Единственный читатель работает без мьютекса: он читает write_pos с
+ * acquire (данные писателя уже видны) и публикует read_pos с release
+ * (писатель не затрет байты, которые еще копируются). Разбор и
+ * копирование сообщения - scull_ring_take_message; с rf->read_meta перед
+ * данными отдается struct scull_ring_rec_hdr, и count должен быть больше
+ * заголовка (иначе -EINVAL).
+ */
+static int scull_ring_buffer_read(struct scull_ring_buffer *buf, struct scull_ring_file *rf,
+                                  char __user *user_buf, size_t count, bool nonblock) {
+    unsigned int read_pos;
+    unsigned int hdr_len = READ_ONCE(rf->read_meta) ? sizeof(struct scull_ring_rec_hdr) : 0;
+    int data_len;
+    int message_len;
+    int bytes_read;
+    bool locked;
+
+    // С заголовком нужно место хотя бы под байт данных: иначе поток байт
+    // отдал бы пустое сообщение, не сдвинув позицию, а счетчики выросли бы
+    if (hdr_len && count <= hdr_len) {
+        return -EINVAL;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    data_len = scull_ring_read_begin(buf, rf, nonblock, &locked, &read_pos);
+    if (data_len < 0) {
+        return data_len;
+    }
+
+    message_len = scull_ring_take_message(buf, read_pos, data_len, user_buf, count, hdr_len != 0, &bytes_read);
+    if (message_len < 0) {
+        scull_ring_side_exit(buf, &buf->rd, locked);
+        return message_len;
+    }
+
+    scull_ring_read_end(buf, rf, read_pos + message_len, 1, bytes_read, locked);
+    return hdr_len + bytes_read;
+}
+
+/**
+ * Операция записи в кольцевой буфер
+ * @buf: указатель на буфер
+ * @user_buf: буфер пользовательского пространства с данными
+ * @count: количество байт для записи
+ * @nonblock: файл открыт с O_NONBLOCK
+ * Возвращает количество записанных байт или код ошибки
+ * 
+ * Записывает одно сообщение. Если буфер полон, процесс блокируется до
+ * освобождения места или получения сигнала; с O_NONBLOCK возвращается
+ * -EAGAIN.
+ *
+ * Единственный писатель работает без мьютекса: он читает read_pos с
+ * acquire и публикует write_pos с release после копирования данных.
+ */
+static int scull_ring_buffer_write(struct scull_ring_buffer *buf, const char __user *user_buf, size_t count, bool nonblock) {
+    unsigned int write_pos;
+    unsigned int hdr_len;
+    int available;
+    bool locked;
+
+    available = scull_ring_write_begin(buf, count, nonblock, &locked, &write_pos, &hdr_len);
+    if (available < 0) {
+        return available;
+    }
+
+    if (count > available - hdr_len) {
+        // Усечение записи если запрашивается больше чем доступно (только поток байт)
+        count = available - hdr_len;
+    }
+
+    // Копирование данных из пользовательского пространства в кольцевой буфер
+    if (scull_ring_put_message(buf, write_pos, hdr_len, user_buf, count)) {
+        scull_ring_side_exit(buf, &buf->wr, locked);
+        return -EFAULT;
+    }
+
+    scull_ring_write_end(buf, write_pos + hdr_len + count, 1, count, locked);
+    return count;
+}
+
+#endif /* SCULL_RING_CORE_H */
@@ -0,0 +1,312 @@
+// scull_ring_ioctl.h
+// Общий интерфейс драйвера scull_ring для ядра и пользовательских программ
+#ifndef SCULL_RING_IOCTL_H
+#define SCULL_RING_IOCTL_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Управляющая страница кольца, доступная через mmap().
+ *
+ * Раскладка отображения устройства:
+ *   [0, PAGE_SIZE)                    - struct scull_ring_ctrl
+ *   [data_offset, data_offset + size) - данные кольца (data_offset = PAGE_SIZE)
+ *
+ * write_pos и read_pos - свободно растущие счетчики байт; size - степень
+ * двойки, индекс в данных равен pos & (size - 1), заполненность равна
+ * write_pos - read_pos. Писатель
+ * публикует write_pos с release после записи данных, читатель публикует
+ * read_pos с release после их копирования. Поля писателя и читателя лежат
+ * в разных кэш-линиях, чтобы стороны не мешали друг другу.
+ *
+ * *_waiters - число процессов, спящих в ядре на соответствующей очереди.
+ * После сдвига своей позиции процесс должен выполнить полный барьер и,
+ * если противоположный счетчик не ноль, вызвать SCULL_RING_IOCTL_NOTIFY.
+ * Процессы, ждущие в poll()/epoll, в счетчиках не учитываются: если
+ * другая сторона спит в poll(), NOTIFY нужно вызывать после каждой пачки.
+ * Зарегистрированный eventfd читателя (SCULL_RING_IOCTL_SET_EVENTFD)
+ * считается в read_waiters, пока он не снят.
+ */
+struct scull_ring_ctrl {
+    __u32 write_pos;         // Позиция записи (пишет только писатель)
+    __u32 write_waiters;     // Писатели, ждущие места в ядре
+    __u32 __pad0[14];
+
+    __u32 read_pos;          // Позиция чтения (пишет только читатель)
+    __u32 read_waiters;      // Читатели, ждущие данных в ядре
+    __u32 __pad1[14];
+
+    __u32 version;           // Версия раскладки (SCULL_RING_CTRL_VERSION)
+    __u32 size;              // Размер области данных кольца в байтах
+    __u32 data_offset;       // Смещение данных в отображении
+    __u32 flags;             // Режим кольца (SCULL_RING_F_*)
+    __u32 __pad2[12];
+};
+
+#define SCULL_RING_CTRL_VERSION 1
+
+/*
+ * Режимы кольца (SCULL_RING_IOCTL_SET_FLAGS, параметр модуля scull_ring_flags).
+ *
+ * По умолчанию кольцо - поток байт, сообщения разделяются '\0'.
+ * SCULL_RING_F_RECORD: каждая запись хранится как struct scull_ring_rec_hdr
+ * и следом len байт данных; читатель сразу переходит к границе следующей
+ * записи, а запись никогда не усекается (не помещается в кольцо - EMSGSIZE).
+ * SCULL_RING_F_TIMESTAMP: заполнять tstamp_ns и seq в заголовке (с RECORD или
+ * PERCPU; в PERCPU seq выдается только вместе с MERGE).
+ * SCULL_RING_F_OVERWRITE: писатель никогда не ждет - если места нет, он
+ * затирает самые старые целые сообщения и увеличивает счетчик потерь
+ * (SCULL_RING_IOCTL_GET_DROPPED). Кольцо в этом режиме нельзя отобразить
+ * через mmap(), а читатели и писатели всегда работают под мьютексом.
+ * SCULL_RING_F_BROADCAST: каждый файл, начавший читать (первый read() или
+ * звонок данных SET_EVENTFD), становится подписчиком и получает все
+ * сообщения - у него своя позиция чтения, а общая read_pos равна позиции
+ * самого отстающего подписчика. Файл, через который только вызывают
+ * ioctl или poll, подписчиком не становится и место не держит. Без OVERWRITE отстающий удерживает место
+ * и писатель ждет его. С OVERWRITE писатель не ждет, а подписчик, которого
+ * обогнали, получает -EPIPE от следующего read() и продолжает с самого
+ * старого сохранившегося сообщения (SCULL_RING_IOCTL_GET_LAPPED считает
+ * такие случаи). Новый подписчик начинает с самого старого сообщения в
+ * кольце. Как и OVERWRITE, режим исключает mmap().
+ * SCULL_RING_F_PERCPU: у каждого процессора свое подкольцо размера size,
+ * писатели разных процессоров не делят ни мьютекс, ни позиции. Каждый
+ * write() - одно сообщение (датаграмма: read() отдает его целиком или
+ * усекает). Без SCULL_RING_F_MERGE читатель обходит подкольца по кругу и
+ * порядок сохраняется только внутри процессора; с MERGE сообщения
+ * отдаются по метке времени (вместе с SCULL_RING_F_TIMESTAMP) или по
+ * порядковому номеру устройства. Режим задается только при загрузке
+ * модуля, размер не меняется, mmap() недоступен.
+ * SCULL_RING_F_WORKQUEUE: несколько читателей делят поток работы. Спящие
+ * читатели ждут исключительно: запись будит одного свободного читателя,
+ * а тот, забрав сообщение, будит следующего, если в кольце еще что-то
+ * есть. Каждое сообщение достается ровно одному читателю. Не сочетается
+ * с BROADCAST.
+ */
+#define SCULL_RING_F_RECORD     0x0001
+#define SCULL_RING_F_TIMESTAMP  0x0002
+#define SCULL_RING_F_OVERWRITE  0x0004
+#define SCULL_RING_F_BROADCAST  0x0008
+#define SCULL_RING_F_PERCPU     0x0010
+#define SCULL_RING_F_MERGE      0x0020
+#define SCULL_RING_F_WORKQUEUE  0x0040
+
+// Заголовок записи в режиме SCULL_RING_F_RECORD (может переходить через границу кольца)
+struct scull_ring_rec_hdr {
+    __u32 len;               // Длина данных записи без заголовка
+    union {
+        __u32 seq;           // Порядковый номер записи в устройстве (с 1) или 0
+        __u32 reserved;      // Прежнее имя поля
+    };
+    __u64 tstamp_ns;         // CLOCK_MONOTONIC в момент записи (SCULL_RING_F_TIMESTAMP) или 0
+};
+
+/*
+ * Пороги пробуждения (SCULL_RING_IOCTL_SET_WATERMARK).
+ *
+ * Спящий читатель просыпается, когда в кольце набралось read_bytes байт
+ * или read_msgs сообщений, либо через timeout_ms после засыпания, если
+ * в кольце есть хоть что-то. Спящий писатель просыпается, когда свободно
+ * write_bytes байт. Процесс, который пришел к непустому (неполному)
+ * кольцу, работает сразу - пороги влияют только на пробуждения. Если
+ * писатель спит на полном кольце, читатели забирают неполную пачку
+ * без ожидания порога. Значения 0 и 1 - будить на каждое изменение.
+ *
+ * В режиме SCULL_RING_F_BROADCAST read_msgs не поддерживается: каждое
+ * сообщение читает каждый подписчик, и счетчики кольца не дают отставания
+ * отдельного файла. SET_WATERMARK с read_msgs != 0 у такого кольца и
+ * SET_FLAGS с BROADCAST при заданном read_msgs возвращают EINVAL;
+ * read_bytes и timeout_ms работают по позиции подписчика.
+ */
+struct scull_ring_watermark {
+    __u32 read_bytes;        // Порог данных для пробуждения читателей
+    __u32 read_msgs;         // Порог сообщений для пробуждения читателей (0 - не учитывать)
+    __u32 write_bytes;       // Порог свободного места для пробуждения писателей
+    __u32 timeout_ms;        // Предельное ожидание неполной пачки (0 - без ограничения)
+};
+
+/*
+ * Гистограммы устройства (SCULL_RING_IOCTL_GET_HIST, debugfs scull_ring/scull_ringN/hist).
+ *
+ * Шкала логарифмическая: корзина 0 - значение 0, корзина i - значения
+ * [2^(i-1), 2^i), последняя корзина открыта сверху. Времена в наносекундах,
+ * заполненность в байтах. Время пребывания считается по пачкам записи:
+ * от конца write() до момента, когда читатель забрал пачку целиком.
+ */
+#define SCULL_RING_HIST_BUCKETS 32
+
+enum scull_ring_hist_id {
+    SCULL_RING_HIST_RESIDENCY,     // Время от записи данных до их чтения
+    SCULL_RING_HIST_READ_SLEEP,    // Сон читателей на пустом кольце
+    SCULL_RING_HIST_WRITE_SLEEP,   // Сон писателей на полном кольце
+    SCULL_RING_HIST_FILL,          // Заполненность после каждого read()/write()
+    SCULL_RING_HIST_NR
+};
+
+struct scull_ring_hist {
+    __u64 buckets[SCULL_RING_HIST_NR][SCULL_RING_HIST_BUCKETS];
+};
+
+/*
+ * Двоичный снимок содержимого кольца (SCULL_RING_IOCTL_SNAPSHOT).
+ *
+ * Процесс передает version = SCULL_RING_SNAPSHOT_VERSION, массив desc на
+ * nr_desc описателей и буфер data на data_size байт. Ядро копирует в data
+ * сырые байты кольца начиная с read_pos (в формате кольца, с заголовками
+ * или '\0') и описывает каждое целиком попавшее туда сообщение: offset и
+ * len - положение данных сообщения внутри data. На выходе nr_desc и
+ * data_size - сколько заполнено, more - сколько байт кольца осталось за
+ * последним описанным сообщением. Снимок снимается без мьютекса кольца;
+ * копия ограничена размером кольца и SCULL_RING_SNAPSHOT_MAX_DATA.
+ * Форматирование остается пользовательской программе.
+ */
+#define SCULL_RING_SNAPSHOT_VERSION 1
+#define SCULL_RING_SNAPSHOT_MAX_DATA (1u << 20)
+#define SCULL_RING_SNAPSHOT_MAX_DESC 65536
+
+struct scull_ring_rec_desc {
+    __u32 offset;            // Смещение данных сообщения в data
+    __u32 len;               // Длина данных (без заголовка и '\0')
+    __u64 tstamp_ns;         // Метка времени (SCULL_RING_F_TIMESTAMP) или 0
+};
+
+struct scull_ring_snapshot {
+    __u32 version;           // Вход: версия структуры; выход: версия ядра
+    __u32 flags;             // Выход: режим кольца SCULL_RING_F_*
+    __u32 size;              // Выход: размер кольца
+    __u32 data_len;          // Выход: заполненность кольца
+    __u32 read_pos;          // Выход: позиция, с которой начинается data
+    __u32 nr_desc;           // Вход: емкость desc; выход: описано сообщений
+    __u32 data_size;         // Вход: емкость data; выход: скопировано байт
+    __u32 more;              // Выход: байт кольца за последним описанным сообщением
+    __u64 desc;              // Указатель на struct scull_ring_rec_desc[nr_desc]
+    __u64 data;              // Указатель на буфер данных
+};
+
+/*
+ * Статистика всех устройств за один вызов (SCULL_RING_IOCTL_GET_ALL_STATS
+ * на управляющем устройстве /dev/scull_ring_ctl).
+ *
+ * Процесс передает version = SCULL_RING_STATS_VERSION и массив devs на
+ * nr_devs элементов. Ядро заполняет элементы по порядку minor, в nr_devs
+ * возвращает заполненное число, в total_devs - число устройств драйвера.
+ * Значения снимаются без мьютексов колец и могут немного расходиться
+ * между собой.
+ */
+#define SCULL_RING_CTL_NAME "scull_ring_ctl"
+#define SCULL_RING_STATS_VERSION 1
+
+struct scull_ring_dev_stats {
+    __u32 minor;             // Младший номер устройства
+    __u32 flags;             // Режим кольца SCULL_RING_F_*
+    __u32 size;              // Размер кольца
+    __u32 data_len;          // Заполненность кольца
+    __u64 read_msgs;         // Сообщений прочитано
+    __u64 write_msgs;        // Сообщений записано
+    __u64 read_bytes;        // Байт прочитано
+    __u64 write_bytes;       // Байт записано
+    __u64 read_blocked;      // Сколько раз читатели засыпали на пустом кольце
+    __u64 write_blocked;     // Сколько раз писатели засыпали на полном кольце
+    __u64 dropped;           // Сообщений затерто (SCULL_RING_F_OVERWRITE)
+};
+
+struct scull_ring_stats {
+    __u32 version;           // Вход: версия структуры; выход: версия ядра
+    __u32 nr_devs;           // Вход: емкость devs; выход: заполнено элементов
+    __u32 total_devs;        // Выход: количество устройств драйвера
+    __u32 __pad;
+    __u64 devs;              // Указатель на struct scull_ring_dev_stats[nr_devs]
+};
+
+/*
+ * Создание кольца во время работы (SCULL_RING_IOCTL_CREATE на
+ * /dev/scull_ring_ctl, нужен CAP_SYS_ADMIN). minor = SCULL_RING_MINOR_ANY
+ * выбирает первый свободный номер и возвращает его; size = 0 - размер по
+ * умолчанию. Узел /dev/scull_ringN появляется автоматически.
+ * SCULL_RING_IOCTL_DESTROY удаляет кольцо, если оно не открыто и не
+ * отображено (иначе EBUSY).
+ */
+#define SCULL_RING_MINOR_ANY 0xffffffffu
+
+struct scull_ring_create {
+    __u32 minor;             // Вход: номер или SCULL_RING_MINOR_ANY; выход: номер кольца
+    __u32 size;              // Размер кольца (степень двойки) или 0
+    __u32 flags;             // Режим кольца SCULL_RING_F_*
+    __u32 __pad;
+};
+
+/*
+ * Узел NUMA для данных кольца (SCULL_RING_IOCTL_SET_NODE, параметр модуля
+ * scull_ring_nodes): номер узла, SCULL_RING_NODE_ANY или
+ * SCULL_RING_NODE_FIRST_WRITER - перенести данные на узел процессора, с
+ * которого придет первая запись. Данные переносятся только у пустого и не
+ * отображенного кольца (иначе SET_NODE возвращает EBUSY, а перенос к
+ * первому писателю не выполняется).
+ */
+#define SCULL_RING_NODE_ANY          (-1)
+#define SCULL_RING_NODE_FIRST_WRITER (-2)
+
+/*
+ * Активное ожидание читателя (SCULL_RING_IOCTL_SET_BUSY_POLL), аналог
+ * SO_BUSY_POLL: перед тем как заснуть на пустом кольце, read() и
+ * WAIT_READABLE этого файла до N микросекунд проверяют, не пришли ли
+ * данные. Задержка пробуждения меняется на процессорное время. 0 - сразу
+ * спать (по умолчанию).
+ */
+#define SCULL_RING_BUSY_POLL_MAX_US 10000
+
+/*
+ * Дверной звонок (SCULL_RING_IOCTL_SET_EVENTFD): вместо сна в read() или
+ * WAIT_READABLE процесс отдает кольцу eventfd и ждет его в своем цикле
+ * событий (epoll, io_uring). Кольцо прибавляет 1 к счетчику eventfd там
+ * же, где разбудило бы читателя (данных набралось до порогов
+ * SET_WATERMARK) или писателя (освободилось write_bytes). С порогами один
+ * сигнал приходится на пачку сообщений. Звонок принадлежит открытому
+ * файлу; fd = -1 снимает звонки, указанные в events. Звонок данных можно
+ * поставить только на файл, открытый на чтение; в режиме BROADCAST он
+ * делает файл подписчиком, как первый read().
+ */
+#define SCULL_RING_EVENTFD_READ  0x1   // Данные для читателя
+#define SCULL_RING_EVENTFD_WRITE 0x2   // Место для писателя
+
+struct scull_ring_eventfd {
+    __s32 fd;                // eventfd или -1
+    __u32 events;            // SCULL_RING_EVENTFD_*
+};
+
+// Определения IOCTL команд для взаимодействия с пользовательским пространством
+#define SCULL_RING_IOCTL_GET_STATUS _IOR('s', 1, int[4])      // Получить статус буфера
+#define SCULL_RING_IOCTL_GET_COUNTERS _IOR('s', 2, long[2])   // Получить счетчики операций
+#define SCULL_RING_IOCTL_PEEK_BUFFER _IOWR('s', 10, char[512]) // Заглянуть в содержимое буфера
+#define SCULL_RING_IOCTL_SNAPSHOT _IOWR('s', 11, struct scull_ring_snapshot) // Двоичный снимок содержимого
+
+// Ожидание для процессов, работающих с кольцом через mmap()
+#define SCULL_RING_IOCTL_WAIT_READABLE _IO('s', 20)           // Спать, пока кольцо пусто
+#define SCULL_RING_IOCTL_WAIT_WRITABLE _IOW('s', 21, __u32)   // Спать, пока свободно меньше N байт
+#define SCULL_RING_IOCTL_NOTIFY _IO('s', 22)                  // Разбудить спящих после сдвига позиций
+#define SCULL_RING_IOCTL_SET_BUSY_POLL _IOW('s', 23, __u32)   // Крутиться до N мкс перед сном (этот файл)
+#define SCULL_RING_IOCTL_GET_BUSY_POLL _IOR('s', 24, __u32)
+#define SCULL_RING_IOCTL_SET_READ_META _IOW('s', 25, __u32)   // 1 - read() отдает scull_ring_rec_hdr + данные (буфер > заголовка)
+#define SCULL_RING_IOCTL_SET_EVENTFD _IOW('s', 26, struct scull_ring_eventfd) // Звонок eventfd (этот файл)
+
+// Режим и размер кольца: менять можно только у пустого и не отображенного кольца
+#define SCULL_RING_IOCTL_SET_FLAGS _IOW('s', 30, __u32)       // Установить режим SCULL_RING_F_*
+#define SCULL_RING_IOCTL_GET_FLAGS _IOR('s', 31, __u32)       // Получить режим SCULL_RING_F_*
+#define SCULL_RING_IOCTL_SET_SIZE _IOW('s', 32, __u32)        // Новый размер (степень двойки, 64 Б..64 МБ)
+#define SCULL_RING_IOCTL_SET_WATERMARK _IOW('s', 33, struct scull_ring_watermark) // Пороги пробуждения
+#define SCULL_RING_IOCTL_GET_WATERMARK _IOR('s', 34, struct scull_ring_watermark)
+#define SCULL_RING_IOCTL_GET_DROPPED _IOR('s', 35, __u64)     // Сообщений затерто в режиме OVERWRITE
+#define SCULL_RING_IOCTL_GET_LAPPED _IOR('s', 36, __u64)      // Сколько раз этот файл обогнали (BROADCAST)
+#define SCULL_RING_IOCTL_SET_NODE _IOW('s', 37, __s32)        // Узел NUMA для данных (SCULL_RING_NODE_*)
+#define SCULL_RING_IOCTL_GET_NODE _IOR('s', 38, __s32)        // Узел, на котором лежат данные (-1 - любой)
+
+// Телеметрия
+#define SCULL_RING_IOCTL_GET_HIST _IOR('s', 40, struct scull_ring_hist) // Получить гистограммы
+#define SCULL_RING_IOCTL_RESET_HIST _IO('s', 41)              // Обнулить гистограммы
+
+// Управляющее устройство /dev/scull_ring_ctl
+#define SCULL_RING_IOCTL_GET_ALL_STATS _IOWR('s', 50, struct scull_ring_stats) // Статистика всех устройств
+#define SCULL_RING_IOCTL_CREATE _IOWR('s', 51, struct scull_ring_create)      // Создать кольцо
+#define SCULL_RING_IOCTL_DESTROY _IOW('s', 52, __u32)                         // Удалить кольцо по minor
+
+#endif /* SCULL_RING_IOCTL_H */
@@ -0,0 +1,180 @@
+// scull_ring_trace.h
+// Точки трассировки драйвера scull_ring.
+//
+// Выключенная точка стоит одну инструкцию nop (static key), аргументы не
+// вычисляются. Включение:
+//   echo 1 > /sys/kernel/tracing/events/scull_ring/enable
+//   cat /sys/kernel/tracing/trace_pipe
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM scull_ring
+
+#if !defined(_SCULL_RING_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SCULL_RING_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/sched.h>
+
+/*
+ * Завершенное чтение или запись: сколько байт и сообщений прошло,
+ * сколько данных осталось в кольце и шла ли операция под мьютексом.
+ */
+DECLARE_EVENT_CLASS(scull_ring_xfer,
+    TP_PROTO(int minor, int bytes, int messages, unsigned int data_len, bool locked),
+    TP_ARGS(minor, bytes, messages, data_len, locked),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(int, bytes)
+        __field(int, messages)
+        __field(unsigned int, data_len)
+        __field(bool, locked)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->bytes = bytes;
+        __entry->messages = messages;
+        __entry->data_len = data_len;
+        __entry->locked = locked;
+    ),
+
+    TP_printk("minor=%d pid=%d bytes=%d messages=%d data_len=%u locked=%d",
+              __entry->minor, __entry->pid, __entry->bytes, __entry->messages,
+              __entry->data_len, __entry->locked)
+);
+
+DEFINE_EVENT(scull_ring_xfer, scull_ring_read,
+    TP_PROTO(int minor, int bytes, int messages, unsigned int data_len, bool locked),
+    TP_ARGS(minor, bytes, messages, data_len, locked)
+);
+
+DEFINE_EVENT(scull_ring_xfer, scull_ring_write,
+    TP_PROTO(int minor, int bytes, int messages, unsigned int data_len, bool locked),
+    TP_ARGS(minor, bytes, messages, data_len, locked)
+);
+
+/*
+ * Блокировка процесса на пустом (writer=0) или полном (writer=1) кольце
+ * и выход из нее; ret != 0 - сон прерван сигналом.
+ */
+TRACE_EVENT(scull_ring_block,
+    TP_PROTO(int minor, bool writer, unsigned int data_len),
+    TP_ARGS(minor, writer, data_len),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(bool, writer)
+        __field(unsigned int, data_len)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->writer = writer;
+        __entry->data_len = data_len;
+    ),
+
+    TP_printk("minor=%d pid=%d %s BLOCKED data_len=%u",
+              __entry->minor, __entry->pid, __entry->writer ? "writer" : "reader",
+              __entry->data_len)
+);
+
+TRACE_EVENT(scull_ring_unblock,
+    TP_PROTO(int minor, bool writer, unsigned int data_len, int ret),
+    TP_ARGS(minor, writer, data_len, ret),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(bool, writer)
+        __field(unsigned int, data_len)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->writer = writer;
+        __entry->data_len = data_len;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("minor=%d pid=%d %s UNBLOCKED data_len=%u ret=%d",
+              __entry->minor, __entry->pid, __entry->writer ? "writer" : "reader",
+              __entry->data_len, __entry->ret)
+);
+
+// Сторона кольца перешла с пути без блокировки на мьютекс (конкуренция)
+TRACE_EVENT(scull_ring_lock_fallback,
+    TP_PROTO(int minor, bool writer),
+    TP_ARGS(minor, writer),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(bool, writer)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->writer = writer;
+    ),
+
+    TP_printk("minor=%d pid=%d %s side contended, using mutex",
+              __entry->minor, __entry->pid, __entry->writer ? "writer" : "reader")
+);
+
+// Писатель затер старейшие сообщения (SCULL_RING_F_OVERWRITE)
+TRACE_EVENT(scull_ring_drop,
+    TP_PROTO(int minor, unsigned int records, unsigned int bytes),
+    TP_ARGS(minor, records, bytes),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(unsigned int, records)
+        __field(unsigned int, bytes)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->records = records;
+        __entry->bytes = bytes;
+    ),
+
+    TP_printk("minor=%d pid=%d dropped records=%u bytes=%u",
+              __entry->minor, __entry->pid, __entry->records, __entry->bytes)
+);
+
+TRACE_EVENT(scull_ring_ioctl,
+    TP_PROTO(int minor, unsigned int cmd),
+    TP_ARGS(minor, cmd),
+
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(pid_t, pid)
+        __field(unsigned int, cmd)
+    ),
+
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pid = current->pid;
+        __entry->cmd = cmd;
+    ),
+
+    TP_printk("minor=%d pid=%d cmd=0x%x", __entry->minor, __entry->pid, __entry->cmd)
+);
+
+#endif /* _SCULL_RING_TRACE_H */
+
+// Заголовок лежит рядом с модулем, а не в include/trace/events
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE scull_ring_trace
+#include <trace/define_trace.h>
@@ -2,12 +2,7 @@
 
 echo "Выгрузка драйвера scull_ring..."
 
-# Удаляем узлы устройств
-sudo rm -f /dev/scull_ring0
-sudo rm -f /dev/scull_ring1
-sudo rm -f /dev/scull_ring2
-
-# Выгружаем модуль
+# Выгружаем модуль (узлы устройств удаляются вместе с ним)
 sudo rmmod scull_ring
 
-echo "Драйвер выгружен"
\ No newline at end of file
+echo "Драйвер выгружен"
@@ -0,0 +1,132 @@
+// ring_bench.c
+// Микробенчмарк ядра кольца scull_ring в пользовательском пространстве
+//
+// Замеры (нс на операцию):
+//   write+read - запись и чтение одного сообщения в одном потоке
+//                (стоимость формата и копирования без конкуренции);
+//   spsc       - писатель и читатель в разных потоках, нс на сообщение;
+//   peek       - разбор заполненного кольца extract_messages.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "scull_ring_user.h"
+
+#define RING_SIZE 65536
+
+static unsigned long iterations = 1000000;
+
+struct spsc_arg {
+    struct scull_ring_buffer *buf;
+    unsigned int msg_size;
+};
+
+static double elapsed_ns(u64 start) {
+    return (double)(ktime_get_ns() - start);
+}
+
+/**
+ * Подготовка сообщения: в потоке байт строка с '\0' на конце
+ */
+static void fill_message(char *msg, unsigned int size) {
+    memset(msg, 'a', size);
+    msg[size - 1] = '\0';
+}
+
+static void bench_write_read(unsigned int flags, unsigned int msg_size) {
+    struct scull_ring_buffer buf;
+    char msg[4096], out[4096 + sizeof(struct scull_ring_rec_hdr)];
+    unsigned long i;
+    u64 start;
+
+    scull_ring_user_init(&buf, RING_SIZE, flags);
+    fill_message(msg, msg_size);
+    start = ktime_get_ns();
+    for (i = 0; i < iterations; i++) {
+        if (scull_ring_user_write(&buf, msg, msg_size, true) != msg_size ||
+            scull_ring_user_read(&buf, out, sizeof(out), false, true) < 0) {
+            fprintf(stderr, "write+read failed at %lu\n", i);
+            exit(1);
+        }
+    }
+    printf("write+read  %-7s size=%-5u %8.1f ns/op\n", flags ? "record" : "stream", msg_size,
+           elapsed_ns(start) / iterations);
+    scull_ring_user_destroy(&buf);
+}
+
+static void *spsc_producer(void *p) {
+    struct spsc_arg *arg = p;
+    char msg[4096];
+    unsigned long i;
+
+    fill_message(msg, arg->msg_size);
+    for (i = 0; i < iterations; i++) {
+        scull_ring_user_write(arg->buf, msg, arg->msg_size, false);
+    }
+    scull_ring_user_close(arg->buf);
+    return NULL;
+}
+
+static void bench_spsc(unsigned int flags, unsigned int msg_size) {
+    struct scull_ring_buffer buf;
+    struct spsc_arg arg = { &buf, msg_size };
+    char out[4096];
+    unsigned long msgs = 0;
+    pthread_t producer;
+    u64 start;
+
+    scull_ring_user_init(&buf, RING_SIZE, flags);
+    start = ktime_get_ns();
+    pthread_create(&producer, NULL, spsc_producer, &arg);
+    while (scull_ring_user_read(&buf, out, sizeof(out), false, false) > 0) {
+        msgs++;
+    }
+    pthread_join(producer, NULL);
+    printf("spsc        %-7s size=%-5u %8.1f ns/msg (%lu msgs)\n", flags ? "record" : "stream", msg_size,
+           elapsed_ns(start) / msgs, msgs);
+    scull_ring_user_destroy(&buf);
+}
+
+static void bench_peek(unsigned int flags) {
+    struct scull_ring_buffer buf;
+    char msg[32], out[512];
+    unsigned long i, n = iterations / 100;
+    u64 start;
+
+    scull_ring_user_init(&buf, RING_SIZE, flags);
+    fill_message(msg, sizeof(msg));
+    while (scull_ring_user_write(&buf, msg, sizeof(msg), true) == sizeof(msg)) {
+        ;
+    }
+    start = ktime_get_ns();
+    for (i = 0; i < n; i++) {
+        scull_ring_user_peek(&buf, out, sizeof(out));
+    }
+    printf("peek        %-7s full     %8.1f ns/op\n", flags ? "record" : "stream", elapsed_ns(start) / n);
+    scull_ring_user_destroy(&buf);
+}
+
+int main(int argc, char *argv[]) {
+    static const unsigned int sizes[] = { 16, 64, 256, 1024, 4096 };
+    unsigned int flags, i;
+
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 0);
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    for (flags = 0; flags <= SCULL_RING_F_RECORD; flags += SCULL_RING_F_RECORD) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            bench_write_read(flags, sizes[i]);
+        }
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            bench_spsc(flags, sizes[i]);
+        }
+        bench_peek(flags);
+    }
+    return 0;
+}
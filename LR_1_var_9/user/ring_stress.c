@@ -0,0 +1,266 @@
+// ring_stress.c
+// Стресс-тест ядра кольца scull_ring в пользовательском пространстве
+//
+// -m 1 (записи): P писателей и C читателей. Каждая запись несет номер
+// писателя, свой порядковый номер и данные, вычисляемые из них; читатель
+// проверяет данные, возрастание номеров каждого писателя в своей
+// подпоследовательности и заголовок (SET_READ_META). В конце сходятся
+// количество и сумма номеров. Параллельно поток монитора гоняет
+// extract_messages по снимкам кольца.
+// -m 0 (поток байт): один писатель и один читатель; писатель докладывает
+// усеченный остаток, как процесс после короткого write(), читатель
+// сверяет поток байт с генератором.
+// Код возврата 0 - ошибок нет.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "scull_ring_user.h"
+
+#define MAX_THREADS 64
+#define MAX_PAYLOAD 512
+
+struct rec_msg {
+    __u32 producer;
+    __u32 seq;
+    __u32 len;                      // Длина data
+    unsigned char data[MAX_PAYLOAD];
+};
+
+static struct scull_ring_buffer ring;
+static unsigned int producers = 4, consumers = 4, ring_size = 4096, mode = 1;
+static unsigned long messages = 100000;     // На писателя (в потоке байт - килобайт)
+static unsigned int max_payload = MAX_PAYLOAD;  // Данные записи, помещающиеся в кольцо
+static unsigned long errors;
+static unsigned long received, seq_sum;
+static int monitor_running = 1;
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fail(const char *what, unsigned long a, unsigned long b) {
+    pthread_mutex_lock(&result_lock);
+    if (errors++ < 10) {
+        fprintf(stderr, "FAIL: %s (%lu, %lu)\n", what, a, b);
+    }
+    pthread_mutex_unlock(&result_lock);
+}
+
+static unsigned char pattern(__u32 producer, __u32 seq, unsigned int i) {
+    return (unsigned char)(producer * 31 + seq * 7 + i);
+}
+
+static void *rec_producer(void *p) {
+    __u32 id = (__u32)(unsigned long)p;
+    unsigned int seed = id + 1;
+    struct rec_msg msg;
+    unsigned int i, size;
+    ssize_t n;
+
+    for (msg.seq = 0; msg.seq < messages; msg.seq++) {
+        msg.producer = id;
+        msg.len = rand_r(&seed) % (max_payload + 1);
+        for (i = 0; i < msg.len; i++) {
+            msg.data[i] = pattern(id, msg.seq, i);
+        }
+        size = offsetof(struct rec_msg, data) + msg.len;
+        n = scull_ring_user_write(&ring, &msg, size, false);
+        if (n != size) {
+            fail("record write", n, size);
+        }
+    }
+    return NULL;
+}
+
+static void *rec_consumer(void *p) {
+    struct {
+        struct scull_ring_rec_hdr hdr;
+        struct rec_msg msg;
+    } in;
+    long last[MAX_THREADS];
+    unsigned long count = 0, sum = 0;
+    unsigned int i, prev_seq = 0;
+    ssize_t n;
+
+    for (i = 0; i < MAX_THREADS; i++) {
+        last[i] = -1;
+    }
+    while ((n = scull_ring_user_read(&ring, &in, sizeof(in), true, false)) > 0) {
+        if (n < (ssize_t)(sizeof(in.hdr) + offsetof(struct rec_msg, data)) ||
+            in.hdr.len != n - sizeof(in.hdr) ||
+            in.msg.len != in.hdr.len - offsetof(struct rec_msg, data) || in.msg.producer >= producers) {
+            fail("record framing", n, in.hdr.len);
+            continue;
+        }
+        // Номера устройства растут в порядке записи, читатели берут записи по порядку
+        if ((ring.flags & SCULL_RING_F_TIMESTAMP) && prev_seq && (int)(in.hdr.seq - prev_seq) <= 0) {
+            fail("device seq order", prev_seq, in.hdr.seq);
+        }
+        prev_seq = in.hdr.seq;
+        if ((long)in.msg.seq <= last[in.msg.producer]) {
+            fail("producer order", last[in.msg.producer], in.msg.seq);
+        }
+        last[in.msg.producer] = in.msg.seq;
+        for (i = 0; i < in.msg.len; i++) {
+            if (in.msg.data[i] != pattern(in.msg.producer, in.msg.seq, i)) {
+                fail("record payload", in.msg.producer, in.msg.seq);
+                break;
+            }
+        }
+        count++;
+        sum += in.msg.seq;
+    }
+    if (n < 0) {
+        fail("record read", -n, 0);
+    }
+
+    pthread_mutex_lock(&result_lock);
+    received += count;
+    seq_sum += sum;
+    pthread_mutex_unlock(&result_lock);
+    return NULL;
+}
+
+static void *monitor(void *p) {
+    char out[512];
+
+    while (READ_ONCE(monitor_running)) {
+        scull_ring_user_peek(&ring, out, sizeof(out));
+    }
+    return NULL;
+}
+
+// Генератор потока байт: '\0' после каждых 37 байт, чтобы были сообщения
+static char stream_byte(unsigned long i) {
+    return i % 38 == 37 ? '\0' : 'a' + (i * 13) % 26;
+}
+
+static void *stream_producer(void *p) {
+    unsigned long total = messages * 1024, pos = 0;
+    unsigned int seed = 1, len, i;
+    char chunk[MAX_PAYLOAD];
+    ssize_t n;
+
+    while (pos < total) {
+        len = 1 + rand_r(&seed) % MAX_PAYLOAD;
+        if (len > total - pos) {
+            len = total - pos;
+        }
+        for (i = 0; i < len; i++) {
+            chunk[i] = stream_byte(pos + i);
+        }
+        n = scull_ring_user_write(&ring, chunk, len, false);
+        if (n <= 0) {
+            fail("stream write", -n, len);
+            break;
+        }
+        // Короткая запись: остаток уйдет следующим вызовом
+        pos += n;
+    }
+    scull_ring_user_close(&ring);
+    return NULL;
+}
+
+static void *stream_consumer(void *p) {
+    unsigned long pos = 0;
+    unsigned int seed = 2;
+    char chunk[MAX_PAYLOAD];
+    ssize_t n, i;
+
+    while ((n = scull_ring_user_read(&ring, chunk, 1 + rand_r(&seed) % MAX_PAYLOAD, false, false)) > 0) {
+        for (i = 0; i < n; i++) {
+            if (chunk[i] != stream_byte(pos + i)) {
+                fail("stream byte", pos + i, chunk[i]);
+                break;
+            }
+        }
+        pos += n;
+    }
+    received = pos;
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-m 0|1] [-p producers] [-c consumers] [-n messages] [-s ring_size] [-t]\n"
+                    "  -m 1  records (default), -m 0  byte stream (one producer, one consumer)\n"
+                    "  -t    timestamp mode (check device sequence numbers)\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t threads[2 * MAX_THREADS + 1];
+    unsigned int flags, nr = 0, i;
+    unsigned long expect_sum;
+    int opt, timestamps = 0, err;
+    u64 start;
+
+    while ((opt = getopt(argc, argv, "m:p:c:n:s:t")) != -1) {
+        switch (opt) {
+            case 'm': mode = atoi(optarg); break;
+            case 'p': producers = atoi(optarg); break;
+            case 'c': consumers = atoi(optarg); break;
+            case 'n': messages = strtoul(optarg, NULL, 0); break;
+            case 's': ring_size = strtoul(optarg, NULL, 0); break;
+            case 't': timestamps = 1; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (mode > 1 || producers < 1 || consumers < 1 || producers > MAX_THREADS || consumers > MAX_THREADS) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (mode == 0) {
+        producers = consumers = 1;
+    }
+    if (ring_size < MAX_PAYLOAD + offsetof(struct rec_msg, data) + sizeof(struct scull_ring_rec_hdr)) {
+        max_payload = ring_size - offsetof(struct rec_msg, data) - sizeof(struct scull_ring_rec_hdr);
+    }
+    flags = mode ? SCULL_RING_F_RECORD | (timestamps ? SCULL_RING_F_TIMESTAMP : 0) : 0;
+    err = scull_ring_user_init(&ring, ring_size, flags);
+    if (err) {
+        fprintf(stderr, "ring init: %s\n", strerror(-err));
+        return 2;
+    }
+
+    start = ktime_get_ns();
+    if (mode == 0) {
+        pthread_create(&threads[nr++], NULL, stream_consumer, NULL);
+        pthread_create(&threads[nr++], NULL, stream_producer, NULL);
+        for (i = 0; i < nr; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        if (received != messages * 1024) {
+            fail("stream length", received, messages * 1024);
+        }
+        printf("stream: %lu bytes in %.3f s, %lu errors\n", received, (ktime_get_ns() - start) / 1e9, errors);
+        scull_ring_user_destroy(&ring);
+        return errors != 0;
+    }
+
+    pthread_create(&threads[nr++], NULL, monitor, NULL);
+    for (i = 0; i < consumers; i++) {
+        pthread_create(&threads[nr++], NULL, rec_consumer, NULL);
+    }
+    for (i = 0; i < producers; i++) {
+        pthread_create(&threads[nr++], NULL, rec_producer, (void *)(unsigned long)i);
+    }
+    // Сначала писатели, потом закрытие кольца и читатели, потом монитор
+    for (i = 1 + consumers; i < nr; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    scull_ring_user_close(&ring);
+    for (i = 1; i < 1 + consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    WRITE_ONCE(monitor_running, 0);
+    pthread_join(threads[0], NULL);
+
+    expect_sum = producers * (messages * (messages - 1) / 2);
+    if (received != producers * messages || seq_sum != expect_sum) {
+        fail("record totals", received, producers * messages);
+    }
+    printf("records: %u producers, %u consumers, %lu messages in %.3f s, %lu errors\n",
+           producers, consumers, received, (ktime_get_ns() - start) / 1e9, errors);
+    scull_ring_user_destroy(&ring);
+    return errors != 0;
+}
@@ -0,0 +1,214 @@
+// scull_ring_shim.h
+// Замены примитивов ядра для сборки scull_ring_core.h в пользовательском
+// пространстве: атомарные операции и барьеры через встроенные функции
+// GCC, mutex, wait_var_event и очереди ожидания через pthread,
+// copy_*_user через memcpy.
+#ifndef SCULL_RING_SHIM_H
+#define SCULL_RING_SHIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define __user
+
+// Перезапуск системного вызова после сигнала (include/linux/errno.h)
+#define ERESTARTSYS 512
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); _a < _b ? _a : _b; })
+#define max(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); _a > _b ? _a : _b; })
+#define min_t(type, a, b) min((type)(a), (type)(b))
+#define max_t(type, a, b) max((type)(a), (type)(b))
+#define clamp_t(type, v, lo, hi) min_t(type, max_t(type, v, lo), hi)
+
+// Порядок памяти: те же гарантии, что у одноименных макросов ядра
+#define READ_ONCE(x)            __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v)        __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define smp_load_acquire(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define smp_mb()                __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_mb__before_atomic() smp_mb()
+#define smp_mb__after_atomic()  smp_mb()
+
+typedef struct {
+    int counter;
+} atomic_t;
+
+static inline int atomic_read(const atomic_t *v) {
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_read_acquire(const atomic_t *v) {
+    return __atomic_load_n(&v->counter, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_set(atomic_t *v, int i) {
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+// Операции с результатом - полный барьер, как в ядре
+static inline int atomic_inc_return(atomic_t *v) {
+    return __atomic_add_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline int atomic_dec_return(atomic_t *v) {
+    return __atomic_sub_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+// В ядре inc/dec упорядочивают smp_mb__before/after_atomic. Здесь сами
+// операции полные: на x86 это та же инструкция с lock, а ThreadSanitizer
+// видит упорядочение через атомарные операции, но не через барьеры
+static inline void atomic_inc(atomic_t *v) {
+    __atomic_add_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_dec(atomic_t *v) {
+    __atomic_sub_fetch(&v->counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_add(int i, atomic_t *v) {
+    __atomic_add_fetch(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+    long counter;
+} atomic_long_t;
+
+static inline long atomic_long_read(const atomic_long_t *v) {
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_long_inc(atomic_long_t *v) {
+    __atomic_add_fetch(&v->counter, 1, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+    int64_t counter;
+} atomic64_t;
+
+static inline int64_t atomic64_read(const atomic64_t *v) {
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_add(int64_t i, atomic64_t *v) {
+    __atomic_add_fetch(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline u64 ktime_get_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// "Пользовательский" буфер - обычная память процесса, копирование не падает
+static inline unsigned long copy_to_user(void *to, const void *from, unsigned long n) {
+    memcpy(to, from, n);
+    return 0;
+}
+
+static inline unsigned long copy_from_user(void *to, const void *from, unsigned long n) {
+    memcpy(to, from, n);
+    return 0;
+}
+
+struct mutex {
+    pthread_mutex_t m;
+};
+
+static inline void mutex_init(struct mutex *lock) {
+    pthread_mutex_init(&lock->m, NULL);
+}
+
+static inline void mutex_destroy(struct mutex *lock) {
+    pthread_mutex_destroy(&lock->m);
+}
+
+static inline void mutex_lock(struct mutex *lock) {
+    pthread_mutex_lock(&lock->m);
+}
+
+static inline void mutex_unlock(struct mutex *lock) {
+    pthread_mutex_unlock(&lock->m);
+}
+
+// Сигналов нет: захват всегда успешен
+static inline int mutex_lock_interruptible(struct mutex *lock) {
+    mutex_lock(lock);
+    return 0;
+}
+
+/*
+ * Очередь ожидания: условная переменная со своим мьютексом. Пробуждение
+ * берет мьютекс очереди, поэтому условие, ставшее истинным до
+ * wake_up_interruptible(), ждущий увидит - пробуждение не теряется.
+ * Сигналов нет: ожидание всегда возвращает 0.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} wait_queue_head_t;
+
+static inline void init_waitqueue_head(wait_queue_head_t *wq) {
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_cond_init(&wq->cond, NULL);
+}
+
+static inline void destroy_waitqueue_head(wait_queue_head_t *wq) {
+    pthread_cond_destroy(&wq->cond);
+    pthread_mutex_destroy(&wq->lock);
+}
+
+static inline void wake_up_interruptible(wait_queue_head_t *wq) {
+    pthread_mutex_lock(&wq->lock);
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+}
+
+#define wait_event_interruptible(wq, condition) ({                  \
+    pthread_mutex_lock(&(wq).lock);                                 \
+    while (!(condition)) {                                          \
+        pthread_cond_wait(&(wq).cond, &(wq).lock);                  \
+    }                                                               \
+    pthread_mutex_unlock(&(wq).lock);                               \
+    0;                                                              \
+})
+
+/*
+ * Ожидание условия на переменной (wait_var_event/wake_up_var). Ядро
+ * раскладывает переменные по хэш-таблице очередей; здесь одна общая пара
+ * мьютекс и условная переменная на процесс - ожидания редкие (откат
+ * стороны на мьютекс), а лишнее пробуждение только перепроверит условие.
+ * Условие меняется до wake_up_var(), а проверяется под мьютексом, поэтому
+ * пробуждение не теряется.
+ */
+extern pthread_mutex_t scull_ring_var_lock;
+extern pthread_cond_t scull_ring_var_cond;
+
+static inline void wake_up_var(void *var) {
+    (void)var;
+    pthread_mutex_lock(&scull_ring_var_lock);
+    pthread_cond_broadcast(&scull_ring_var_cond);
+    pthread_mutex_unlock(&scull_ring_var_lock);
+}
+
+#define wait_var_event(var, condition) do {                            \
+    (void)(var);                                                       \
+    pthread_mutex_lock(&scull_ring_var_lock);                          \
+    while (!(condition)) {                                             \
+        pthread_cond_wait(&scull_ring_var_cond, &scull_ring_var_lock); \
+    }                                                                  \
+    pthread_mutex_unlock(&scull_ring_var_lock);                        \
+} while (0)
+
+#endif /* SCULL_RING_SHIM_H */
@@ -0,0 +1,190 @@
+// scull_ring_user.c
+// Операции кольца в пользовательском пространстве поверх scull_ring_core.h
+#include <stdlib.h>
+
+#include "scull_ring_user.h"
+
+// Точек трассировки в пользовательском пространстве нет
+static inline void trace_scull_ring_block(int minor, bool write, unsigned int data_len) {}
+static inline void trace_scull_ring_unblock(int minor, bool write, unsigned int data_len, int ret) {}
+static inline void trace_scull_ring_lock_fallback(int minor, bool write) {}
+
+#include "../scull_ring_core.h"
+
+#define SCULL_RING_USER_MIN_SIZE 64
+#define SCULL_RING_USER_MAX_SIZE (64u << 20)
+
+pthread_mutex_t scull_ring_var_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t scull_ring_var_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Создание кольца
+ * @buf: структура кольца
+ * @size: размер (степень двойки, 64 Б..64 МБ)
+ * @flags: SCULL_RING_F_RECORD, SCULL_RING_F_TIMESTAMP или 0
+ * Возвращает 0 или -EINVAL/-ENOMEM
+ */
+int scull_ring_user_init(struct scull_ring_buffer *buf, unsigned int size, unsigned int flags) {
+    if (size < SCULL_RING_USER_MIN_SIZE || size > SCULL_RING_USER_MAX_SIZE || (size & (size - 1))) {
+        return -EINVAL;
+    }
+    if (flags & ~(SCULL_RING_F_RECORD | SCULL_RING_F_TIMESTAMP)) {
+        return -EINVAL;
+    }
+    if ((flags & SCULL_RING_F_TIMESTAMP) && !(flags & SCULL_RING_F_RECORD)) {
+        return -EINVAL;
+    }
+
+    memset(buf, 0, sizeof(*buf));
+    buf->ctrl = aligned_alloc(64, sizeof(*buf->ctrl));
+    buf->data = malloc(size);
+    if (!buf->ctrl || !buf->data) {
+        free(buf->ctrl);
+        free(buf->data);
+        return -ENOMEM;
+    }
+    memset(buf->ctrl, 0, sizeof(*buf->ctrl));
+    buf->ctrl->version = SCULL_RING_CTRL_VERSION;
+    buf->ctrl->size = size;
+    buf->ctrl->flags = flags;
+    buf->size = size;
+    buf->mask = size - 1;
+    buf->flags = flags;
+    mutex_init(&buf->lock);
+    init_waitqueue_head(&buf->write_queue);
+    init_waitqueue_head(&buf->read_queue);
+    return 0;
+}
+
+void scull_ring_user_destroy(struct scull_ring_buffer *buf) {
+    destroy_waitqueue_head(&buf->read_queue);
+    destroy_waitqueue_head(&buf->write_queue);
+    mutex_destroy(&buf->lock);
+    free(buf->data);
+    free(buf->ctrl);
+}
+
+/**
+ * Закрытие кольца для читателей: когда данные кончатся, read() вернет 0
+ */
+void scull_ring_user_close(struct scull_ring_buffer *buf) {
+    smp_store_release(&buf->closed, true);
+    wake_up_interruptible(&buf->read_queue);
+}
+
+static unsigned int scull_ring_data_len(struct scull_ring_buffer *buf) {
+    return smp_load_acquire(&buf->ctrl->write_pos) - smp_load_acquire(&buf->ctrl->read_pos);
+}
+
+unsigned int scull_ring_user_data_len(struct scull_ring_buffer *buf) {
+    return scull_ring_data_len(buf);
+}
+
+/*
+ * Режимы OVERWRITE и BROADCAST scull_ring_user_init не принимает, а
+ * гистограммы пребывания в пользовательском кольце нет - эти функции
+ * протокола сторон ничего не делают.
+ */
+static unsigned int scull_ring_broadcast_advance(struct scull_ring_buffer *buf) {
+    return buf->ctrl->read_pos;
+}
+
+static unsigned int scull_ring_overwrite(struct scull_ring_buffer *buf, unsigned int write_pos, unsigned int need) {
+    return buf->size - (write_pos - buf->ctrl->read_pos);
+}
+
+static void scull_ring_mark_read(struct scull_ring_buffer *buf, unsigned int read_pos) {}
+static void scull_ring_mark_write(struct scull_ring_buffer *buf, unsigned int write_pos) {}
+
+/**
+ * Пробуждение противоположной стороны после сдвига позиции
+ * Барьер парный к увеличению счетчика ждущих в scull_ring_user_wait:
+ * либо мы видим ждущего, либо он видит новую позицию.
+ */
+static void scull_ring_user_notify(__u32 *waiters, wait_queue_head_t *wq) {
+    smp_mb();
+    if (READ_ONCE(*waiters)) {
+        wake_up_interruptible(wq);
+    }
+}
+
+#define scull_ring_user_wait(waiters, wq, condition) do {           \
+    __atomic_add_fetch((waiters), 1, __ATOMIC_SEQ_CST);             \
+    wait_event_interruptible(wq, condition);                        \
+    __atomic_sub_fetch((waiters), 1, __ATOMIC_SEQ_CST);             \
+} while (0)
+
+/**
+ * Ожидание данных (сторона читателей уже освобождена)
+ * Возвращает 0 или -ENODATA, если кольцо закрыто и пусто
+ */
+static int scull_ring_wait_readable(struct scull_ring_buffer *buf, struct scull_ring_file *rf) {
+    scull_ring_user_wait(&buf->ctrl->read_waiters, buf->read_queue,
+                         scull_ring_data_len(buf) || smp_load_acquire(&buf->closed));
+    return scull_ring_data_len(buf) ? 0 : -ENODATA;
+}
+
+/**
+ * Ожидание need байт свободного места (сторона писателей уже освобождена)
+ */
+static int scull_ring_wait_writable(struct scull_ring_buffer *buf, unsigned int need) {
+    scull_ring_user_wait(&buf->ctrl->write_waiters, buf->write_queue,
+                         buf->size - scull_ring_data_len(buf) >= need);
+    return 0;
+}
+
+static void scull_ring_read_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked) {
+    scull_ring_user_notify(&buf->ctrl->write_waiters, &buf->write_queue);
+}
+
+static void scull_ring_write_done(struct scull_ring_buffer *buf, int messages, int bytes, bool locked) {
+    scull_ring_user_notify(&buf->ctrl->read_waiters, &buf->read_queue);
+}
+
+/**
+ * Чтение одного сообщения (scull_ring_buffer_read модуля)
+ * @meta: класть перед данными struct scull_ring_rec_hdr (как SET_READ_META)
+ * Возвращает количество байт, 0 - кольцо закрыто и пусто, или -errno
+ */
+ssize_t scull_ring_user_read(struct scull_ring_buffer *buf, void *dst, size_t count, bool meta, bool nonblock) {
+    struct scull_ring_file rf = { .read_meta = meta };
+    int ret;
+
+    ret = scull_ring_buffer_read(buf, &rf, dst, count, nonblock);
+    return ret == -ENODATA ? 0 : ret;
+}
+
+/**
+ * Запись одного сообщения (scull_ring_buffer_write модуля)
+ * Возвращает количество байт (поток байт усекается по свободному месту),
+ * -EMSGSIZE для записи больше кольца или -EAGAIN
+ */
+ssize_t scull_ring_user_write(struct scull_ring_buffer *buf, const void *src, size_t count, bool nonblock) {
+    if (count == 0) {
+        return 0;
+    }
+    return scull_ring_buffer_write(buf, src, count, nonblock);
+}
+
+/**
+ * Форматирование содержимого кольца, как PEEK_BUFFER модуля
+ * Возвращает количество показанных сообщений
+ *
+ * Копия снимается при захваченном кольце (scull_ring_lock_all), разбор
+ * идет по копии тем же extract_messages, что и в модуле.
+ */
+int scull_ring_user_peek(struct scull_ring_buffer *buf, char *output, int output_size) {
+    struct scull_ring_snap snap;
+    char data[4096];
+
+    scull_ring_lock_all(buf);
+    snap.read_pos = buf->ctrl->read_pos;
+    snap.data_len = buf->ctrl->write_pos - snap.read_pos;
+    snap.size = buf->size;
+    snap.flags = buf->flags;
+    snap.len = min(snap.data_len, (unsigned int)sizeof(data));
+    scull_ring_peek(buf, snap.read_pos, data, snap.len);
+    scull_ring_unlock_all(buf);
+
+    return extract_messages(&snap, data, output, output_size);
+}
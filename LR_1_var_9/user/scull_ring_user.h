@@ -0,0 +1,63 @@
+// scull_ring_user.h
+// Кольцо scull_ring в пользовательском пространстве: тот же формат и
+// тот же протокол сторон (scull_ring_core.h), что в модуле, для замеров
+// и стресс-тестов без загрузки драйвера.
+//
+// Поддерживаются поток байт и режим записей (SCULL_RING_F_RECORD,
+// SCULL_RING_F_TIMESTAMP), то есть режимы, где модуль работает без
+// мьютекса: единственный читатель и единственный писатель передают данные
+// через позиции с acquire/release, а при конкуренции сторона уходит на
+// buf->lock. Ожидание - pthread вместо очередей ядра (scull_ring_shim.h).
+#ifndef SCULL_RING_USER_H
+#define SCULL_RING_USER_H
+
+#include <sys/types.h>
+
+#include "scull_ring_shim.h"
+#include "../scull_ring_ioctl.h"
+
+// Сторона кольца (читатели или писатели), как в модуле
+struct scull_ring_side {
+    atomic_t inflight;              // Операции стороны без мьютекса
+    atomic_t locked;                // Операции стороны под мьютексом
+    atomic_long_t contended;        // Уходы стороны на мьютекс из-за другого потока
+};
+
+// Состояние читателя: поля, нужные scull_ring_buffer_read
+struct scull_ring_file {
+    unsigned int cursor;            // Позиция BROADCAST (в user/ не используется)
+    unsigned long lapped;
+    bool read_meta;                 // Заголовок записи перед данными
+};
+
+struct scull_ring_buffer {
+    int minor;                      // Для трассировки (в user/ всегда 0)
+    struct scull_ring_ctrl *ctrl;   // Позиции и счетчики ждущих (как управляющая страница модуля)
+    char *data;                     // Данные кольца
+    unsigned int size;              // Размер (степень двойки)
+    unsigned int mask;              // size - 1
+    unsigned int flags;             // SCULL_RING_F_RECORD | SCULL_RING_F_TIMESTAMP
+    atomic_t seq;                   // Порядковый номер записей
+    bool closed;                    // scull_ring_user_close: читатели получают 0 на пустом кольце
+    struct mutex lock;              // Откат сторон при конкуренции (scull_ring_side_enter)
+
+    struct scull_ring_side wr;      // Писатели
+    wait_queue_head_t write_queue;
+    atomic_t write_count;
+    atomic64_t write_bytes;
+
+    struct scull_ring_side rd;      // Читатели
+    wait_queue_head_t read_queue;
+    atomic_t read_count;
+    atomic64_t read_bytes;
+};
+
+int scull_ring_user_init(struct scull_ring_buffer *buf, unsigned int size, unsigned int flags);
+void scull_ring_user_destroy(struct scull_ring_buffer *buf);
+void scull_ring_user_close(struct scull_ring_buffer *buf);
+unsigned int scull_ring_user_data_len(struct scull_ring_buffer *buf);
+ssize_t scull_ring_user_read(struct scull_ring_buffer *buf, void *dst, size_t count, bool meta, bool nonblock);
+ssize_t scull_ring_user_write(struct scull_ring_buffer *buf, const void *src, size_t count, bool nonblock);
+int scull_ring_user_peek(struct scull_ring_buffer *buf, char *output, int output_size);
+
+#endif /* SCULL_RING_USER_H */